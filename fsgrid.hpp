@@ -29,6 +29,30 @@
 #include <cassert>
 #include <stdio.h>
 #include <algorithm>
+#include <utility>
+#include <cmath>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <cstdlib>
+#include <new>
+#include <map>
+#include <memory>
+#include <string>
+// The POSIX headers for mmap() (FsGridChunkedReader) and madvise() (huge pages) bring a lot
+// of global names along, so they are only included if FSGRID_USE_POSIX is defined.
+#if defined(FSGRID_USE_POSIX) && __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define FSGRID_MMAP
+#endif
 
 #ifndef FS_MASTER_RANK
 #define FS_MASTER_RANK 0
@@ -43,6 +67,26 @@ struct FsGridTools{
    typedef int64_t GlobalID;
    typedef int Task_t; 
 
+   //! Default cache tile shape of the cell iteration functions (forEachCell() etc.):
+   // full rows in x, to keep the innermost loop long and unit-stride, times a small
+   // y-z block so that the neighbouring rows of a stencil stay in cache.
+   // Chosen with timeTiling() in tests/benchmark.cpp; tune with setTileSize().
+   static constexpr std::array<FsIndex_t, 3> defaultTileSize = {1024, 16, 16};
+
+   //! MPI datatype of an arithmetic type
+   template<typename V> static MPI_Datatype mpiDatatype() {
+      static_assert(std::is_arithmetic<V>::value, "FsGridTools::mpiDatatype() needs an arithmetic type");
+      if constexpr (std::is_floating_point<V>::value) {
+         return sizeof(V) == sizeof(float) ? MPI_FLOAT : sizeof(V) == sizeof(double) ? MPI_DOUBLE : MPI_LONG_DOUBLE;
+      } else if constexpr (std::is_same<V, bool>::value) {
+         return MPI_CXX_BOOL;
+      } else if constexpr (std::is_signed<V>::value) {
+         return sizeof(V) == 1 ? MPI_INT8_T : sizeof(V) == 2 ? MPI_INT16_T : sizeof(V) == 4 ? MPI_INT32_T : MPI_INT64_T;
+      } else {
+         return sizeof(V) == 1 ? MPI_UINT8_T : sizeof(V) == 2 ? MPI_UINT16_T : sizeof(V) == 4 ? MPI_UINT32_T : MPI_UINT64_T;
+      }
+   }
+
    //! Helper function: calculate position of the local coordinate space for the given dimension
    // \param globalCells Number of cells in the global Simulation, in this dimension
    // \param ntasks Total number of tasks in this dimension
@@ -59,6 +103,32 @@ struct FsGridTools{
       }
    }
 
+   //! Helper function: find the task responsible for the given cell in one dimension
+   // This is the inverse of calcLocalStart / calcLocalSize.
+   // \param globalCells Number of cells in the global Simulation, in this dimension
+   // \param ntasks Total number of tasks in this dimension
+   // \param cell Global cell coordinate in this dimension
+   // \return Position of the responsible task in this dimension
+   static Task_t calcTaskIndex(FsSize_t globalCells, Task_t ntasks, FsIndex_t cell) {
+      FsIndex_t n_per_task = globalCells / ntasks;
+      FsIndex_t remainder = globalCells % ntasks;
+
+      if(cell < remainder * (n_per_task+1)) {
+         return cell / (n_per_task + 1);
+      } else {
+         return remainder + (cell - remainder*(n_per_task+1)) / n_per_task;
+      }
+   }
+
+   //! Helper function: rank of the task at the given position of the task grid
+   // FsGrid creates its cartesian communicators without reordering, so ranks
+   // are laid out in row-major order with the z-position running fastest.
+   // \param taskPosition Position of the task in the 3d task grid
+   // \param ntasksPerDim Number of tasks in each direction
+   static Task_t taskPositionToRank(const std::array<Task_t, 3>& taskPosition, const std::array<Task_t, 3>& ntasksPerDim) {
+      return (taskPosition[0] * ntasksPerDim[1] + taskPosition[1]) * ntasksPerDim[2] + taskPosition[2];
+   }
+
    //! Helper function: given a global cellID, calculate the global cell coordinate from it.
    // This is then used do determine the task responsible for this cell, and the
    // local cell index in it.
@@ -94,6 +164,41 @@ struct FsGridTools{
       }
    }
 
+   /*! Size of a task's storage in one dimension, as laid out by its storage layout:
+    * the local size plus ghost cells (or a single cell for collapsed dimensions),
+    * with rows rounded up to a multiple of rowAlignment cells. If conflictStride is
+    * nonzero, rows and planes are padded further until their size in bytes isn't a
+    * multiple of it, so that neighbouring rows and planes don't map to the same cache sets.
+    * \param dim Dimension, 0 to 2
+    * \param size Local size plus ghost cells in this dimension
+    * \param rowCells Storage size in x, as returned for dim 0 (needed for dim 1)
+    * \param collapsed Whether each dimension is collapsed
+    * \param rowAlignment Row alignment of the layout, a power of two
+    * \param conflictStride Conflict stride of the layout in bytes, zero for no padding
+    * \param cellBytes Size of a cell
+    */
+   static int64_t calcStorageSize(int dim, int64_t size, int64_t rowCells, const std::array<bool, 3>& collapsed,
+         int rowAlignment, int conflictStride, size_t cellBytes) {
+      if(collapsed[dim]) {
+         return 1;
+      }
+      if(dim == 0) {
+         size = (size + rowAlignment - 1) & ~(int64_t)(rowAlignment - 1);
+         if(conflictStride > 0) {
+            // Pad by a cache line's worth of cells, in whole multiples of the row alignment
+            const int64_t lineCells = ((64 + cellBytes - 1) / cellBytes + rowAlignment - 1) & ~(int64_t)(rowAlignment - 1);
+            for(int i=0; i<8 && size * cellBytes % conflictStride == 0; i++) {
+               size += lineCells;
+            }
+         }
+      } else if(dim == 1 && conflictStride > 0 && !collapsed[2]) {
+         for(int i=0; i<8 && rowCells * size * cellBytes % conflictStride == 0; i++) {
+            size++;
+         }
+      }
+      return size;
+   }
+
    //! Helper function to optimize decomposition of this grid over the given number of tasks
    static void computeDomainDecomposition(const std::array<FsSize_t, 3>& GlobalSize, Task_t nProcs, std::array<Task_t,3>& processDomainDecomposition, int stencilSize=1, int verbose = 0) {
       int myRank, MPI_flag;
@@ -197,290 +302,3455 @@ struct FsGridTools{
          " \n";
       }
    }
-      
 
+   //! One box of cells exchanged with another task
+   struct BoxTransfer {
+      Task_t task; //!< Rank of the other task in the parent communicator
+      std::array<FsIndex_t, 3> localStart; //!< Start of the box in our own local coordinates
+      std::array<FsIndex_t, 3> size; //!< Size of the box in cells
+      size_t offset; //!< Offset of the box in the packed buffer, in cells
+      size_t count; //!< Number of cells in the box
+   };
+
+   /*! Intersect our own box with the task boxes of another grid's decomposition.
+    * Transfers come out sorted by the other task's rank.
+    * \return Total number of cells in all transfers
+    */
+   static size_t computeBoxTransfers(const std::array<FsSize_t, 3>& globalSize, const std::array<FsIndex_t, 3>& localStart,
+         const std::array<FsIndex_t, 3>& localSize, const std::array<Task_t, 3>& otherDecomposition, std::vector<BoxTransfer>& transfers) {
+      std::array<Task_t, 3> firstTask, lastTask;
+      for(int i=0; i<3; i++) {
+         firstTask[i] = calcTaskIndex(globalSize[i], otherDecomposition[i], localStart[i]);
+         lastTask[i] = calcTaskIndex(globalSize[i], otherDecomposition[i], localStart[i] + localSize[i] - 1);
+      }
+
+      size_t offset = 0;
+      std::array<Task_t, 3> task;
+      for(task[0] = firstTask[0]; task[0] <= lastTask[0]; task[0]++) {
+         for(task[1] = firstTask[1]; task[1] <= lastTask[1]; task[1]++) {
+            for(task[2] = firstTask[2]; task[2] <= lastTask[2]; task[2]++) {
+               BoxTransfer t;
+               t.task = taskPositionToRank(task, otherDecomposition);
+               t.count = 1;
+               for(int i=0; i<3; i++) {
+                  const FsIndex_t otherStart = calcLocalStart(globalSize[i], otherDecomposition[i], task[i]);
+                  const FsIndex_t otherEnd = otherStart + calcLocalSize(globalSize[i], otherDecomposition[i], task[i]);
+                  const FsIndex_t start = std::max(localStart[i], otherStart);
+                  const FsIndex_t end = std::min(localStart[i] + localSize[i], otherEnd);
+                  t.localStart[i] = start - localStart[i];
+                  t.size[i] = end - start;
+                  t.count *= t.size[i];
+               }
+               t.offset = offset;
+               offset += t.count;
+               transfers.push_back(t);
+            }
+         }
+      }
+      return offset;
+   }
+
+   /*! Copy the transfers a task makes to itself from the packed send buffer into the packed
+    * receive buffer: the part of the domain we own on both sides never touches MPI.
+    */
+   template<typename T> static void copyOwnTransfers(const std::vector<BoxTransfer>& sends, const std::vector<BoxTransfer>& receives,
+         int rank, const T* sendBuffer, T* receiveBuffer) {
+      for(const BoxTransfer& r : receives) {
+         if(r.task == rank) {
+            for(const BoxTransfer& s : sends) {
+               if(s.task == rank) {
+                  std::copy(sendBuffer + s.offset, sendBuffer + s.offset + s.count, receiveBuffer + r.offset);
+               }
+            }
+         }
+      }
+   }
+
+   //! Displacements of consecutive blocks of the given sizes, e.g. for MPI_Alltoallv()
+   static std::vector<int> displacements(const std::vector<int>& counts) {
+      std::vector<int> displ(counts.size(), 0);
+      for(size_t i=1; i<counts.size(); i++) {
+         displ[i] = displ[i-1] + counts[i-1];
+      }
+      return displ;
+   }
 };
 
-/*! Simple cartesian, non-loadbalancing MPI Grid for use with the fieldsolver
+/*! Closed-form lookup of the owning task and its LocalID for batches of global cells.
  *
- * \param T datastructure containing the field in each cell which this grid manages
- * \param stencil ghost cell width of this grid
+ * Since FsGrid's cartesian communicators are not reordered, the owner of a cell follows
+ * directly from the decomposition, without asking MPI. All divisions are replaced by
+ * multiplications with precomputed reciprocals plus an exact integer correction, and
+ * the remainder split of calcLocalStart is resolved with selects instead of branches.
+ * The storage strides of the owning task only take one of two values per dimension
+ * (tasks with and without a remainder cell), so they are precomputed. The batch loops
+ * are thereby free of branches and calls, and can be vectorized.
+ *
+ * Cells have to lie within the global domain; this is only checked with FSGRID_DEBUG.
  */
-template <typename T, int stencil> class FsGrid : public FsGridTools{
-   template<typename ArrayT> void swapArray(std::array<ArrayT, 3>& array) {
-      ArrayT a = array[0];
-      array[0] = array[2];
-      array[2] = a;
-   }
+class FsGridTaskLookup : public FsGridTools {
    public:
+      FsGridTaskLookup() = default;
 
-      /*! Constructor for this grid.
-       * \param globalSize Cell size of the global simulation domain.
-       * \param MPI_Comm The MPI communicator this grid should use.
-       * \param isPeriodic An array specifying, for each dimension, whether it is to be treated as periodic.
+      /*! \param globalSize Cell size of the global simulation domain
+       * \param ntasksPerDim Number of tasks in each direction
+       * \param stencil Ghost cell width of the grid the LocalIDs refer to
+       * \param rowAlignment Storage rows of the grid are padded to a multiple of this (a power of two)
+       * \param conflictStride Storage padding of the grid's layout, see calcStorageSize()
+       * \param cellBytes Size of a cell of the grid
        */
-   FsGrid(std::array<FsSize_t,3> globalSize, MPI_Comm parent_comm, std::array<bool,3> isPeriodic,
-           const std::array<Task_t, 3>& decomposition = {0,0,0}, bool verbose = false)
-            : globalSize(globalSize) {
-         int status;
-         int size;
-
-         // Get parent_comm info
-         int parentRank;
-         MPI_Comm_rank(parent_comm, &parentRank);
-         int parentSize;
-         MPI_Comm_size(parent_comm, &parentSize);
+      FsGridTaskLookup(const std::array<FsSize_t, 3>& globalSize, const std::array<Task_t, 3>& ntasksPerDim, int stencil,
+            int rowAlignment = 1, int conflictStride = 0, size_t cellBytes = 1) :
+            rowAlignment(rowAlignment), conflictStride(conflictStride), cellBytes(cellBytes) {
+         for(int i=0; i<3; i++) {
+            const int64_t n_per_task = globalSize[i] / ntasksPerDim[i];
+            const bool collapsed = globalSize[i] <= 1;
+            nPerTask[i] = n_per_task;
+            remainder[i] = globalSize[i] % ntasksPerDim[i];
+            split[i] = remainder[i] * (n_per_task + 1);
+            invPerTask[i] = 1.0 / n_per_task;
+            invPerTaskPlusOne[i] = 1.0 / (n_per_task + 1);
+            ghostOffset[i] = collapsed ? 0 : stencil;
+            ghostWidth[i] = collapsed ? 0 : 2 * stencil;
+            this->collapsed[i] = collapsed;
+            globalCells[i] = globalSize[i];
+            invGlobalCells[i] = 1.0 / globalSize[i];
+         }
+         rankStride[0] = ntasksPerDim[1] * ntasksPerDim[2];
+         rankStride[1] = ntasksPerDim[2];
+         rankStride[2] = 1;
+         // Index 1: tasks holding an extra remainder cell
+         for(int large0=0; large0<2; large0++) {
+            const int64_t rowCells = calcStorageSize(0, nPerTask[0] + large0 + ghostWidth[0], 1, collapsed,
+                  rowAlignment, conflictStride, cellBytes);
+            rowStorage[large0] = rowCells;
+            for(int large1=0; large1<2; large1++) {
+               planeStorage[large0][large1] = calcStorageSize(1, nPerTask[1] + large1 + ghostWidth[1], rowCells, collapsed,
+                     rowAlignment, conflictStride, cellBytes);
+            }
+         }
+      }
 
-         // If environment variable FSGRID_PROCS is set, 
-         // use that for determining the number of FS-processes
-         size = parentSize;
-         if(getenv("FSGRID_PROCS") != NULL) {
-            const int fsgridProcs = atoi(getenv("FSGRID_PROCS"));
-            if(fsgridProcs > 0 && fsgridProcs < size)
-               size = fsgridProcs;
+      /*! Find owners of cells given by their global cell coordinates.
+       * Coordinates have to lie within [0, globalSize).
+       * \param n Number of cells
+       * \param x,y,z Global cell coordinates, n each
+       * \param tasks Output: rank of the owning task in the grid's communicator
+       * \param localIDs Output: LocalID of the cell within the owning task
+       */
+      void lookupCoords(size_t n, const FsIndex_t* x, const FsIndex_t* y, const FsIndex_t* z, Task_t* tasks, LocalID* localIDs) const {
+#ifdef FSGRID_DEBUG
+         for(size_t i=0; i<n; i++) {
+            if(x[i] < 0 || x[i] >= globalCells[0] || y[i] < 0 || y[i] >= globalCells[1] || z[i] < 0 || z[i] >= globalCells[2]) {
+               std::cerr << "FsGridTaskLookup: cell (" << x[i] << " " << y[i] << " " << z[i] << ") is outside of the grid." << std::endl;
+               throw std::runtime_error("FsGridTaskLookup cell out of range");
+            }
+         }
+#endif // FSGRID_DEBUG
+         for(size_t i=0; i<n; i++) {
+            lookupOne(x[i], y[i], z[i], tasks[i], localIDs[i]);
          }
+      }
 
-         std::array<Task_t,3> emptyarr = {0,0,0};
-         if (decomposition == emptyarr){
-            // If decomposition isn't pre-defined, heuristically choose a good domain decomposition for our field size
-            computeDomainDecomposition(globalSize, size, ntasksPerDim, stencil, verbose);
-         } else {
-            ntasksPerDim = decomposition;
-            if (ntasksPerDim[0]*ntasksPerDim[1]*ntasksPerDim[2] != size){
-               std::cerr << "Given decomposition ("<<ntasksPerDim[0] << " " << ntasksPerDim[1] << " " << ntasksPerDim[2] << ") does not distribute to the number of tasks given" << std::endl;
-               throw std::runtime_error("Given decomposition does not distribute to the number of tasks given");
+      /*! Find owners of cells given by their GlobalIDs.
+       * GlobalIDs have to lie within [0, globalSize[0] * globalSize[1] * globalSize[2]).
+       * \param n Number of cells
+       * \param ids GlobalIDs of the cells
+       * \param tasks Output: rank of the owning task in the grid's communicator
+       * \param localIDs Output: LocalID of the cell within the owning task
+       */
+      void lookupGlobalIDs(size_t n, const GlobalID* ids, Task_t* tasks, LocalID* localIDs) const {
+#ifdef FSGRID_DEBUG
+         for(size_t i=0; i<n; i++) {
+            if(ids[i] < 0 || ids[i] >= globalCells[0] * globalCells[1] * globalCells[2]) {
+               std::cerr << "FsGridTaskLookup: GlobalID " << ids[i] << " is outside of the grid." << std::endl;
+               throw std::runtime_error("FsGridTaskLookup GlobalID out of range");
             }
-            ntasksPerDim[0] = decomposition[0];
-            ntasksPerDim[1] = decomposition[1];
-            ntasksPerDim[2] = decomposition[2];
          }
-         
-         //set private array
-         periodic = isPeriodic;
-         //set temporary int arrays for MPI_Cart_create
-         std::array<int, 3> isPeriodicInt, ntasksInt;
-         for(unsigned int i=0; i < isPeriodic.size(); i++) {
-            isPeriodicInt[i] = (int)isPeriodic[i];
-            ntasksInt[i] = (int)ntasksPerDim[i];
-         }  
+#endif // FSGRID_DEBUG
+         for(size_t i=0; i<n; i++) {
+            const int64_t xy = divide(ids[i], globalCells[0], invGlobalCells[0]);
+            const int64_t z = divide(xy, globalCells[1], invGlobalCells[1]);
+            lookupOne(ids[i] - xy * globalCells[0], xy - z * globalCells[1], z, tasks[i], localIDs[i]);
+         }
+      }
 
-         // Create a temporary FS subcommunicator for the MPI_Cart_create
-         int colorFs = (parentRank < size) ? 1 : MPI_UNDEFINED;
-         MPI_Comm_split(parent_comm, colorFs, parentRank, &comm1d);
+   private:
+      //! Exact a / b for non-negative a < 2^52, using the reciprocal of b
+      static inline int64_t divide(int64_t a, int64_t b, double invB) {
+         int64_t q = (int64_t)((double)a * invB);
+         const int64_t r = a - q * b;
+         q += (r >= b);
+         q -= (r < 0);
+         return q;
+      }
 
-         if(colorFs != MPI_UNDEFINED){
-           // Create cartesian communicator. Note, that reorder is false so
-           // ranks match the ones in parent_comm
-           status = MPI_Cart_create(comm1d, 3, ntasksPerDim.data(), isPeriodicInt.data(), 0, &comm3d);
+      inline void lookupOne(int64_t x, int64_t y, int64_t z, Task_t& task, LocalID& localID) const {
+         const int64_t cell[3] = {x, y, z};
+         int64_t rank = 0;
+         int64_t offset[3];
+         bool large[3];
+         for(int i=0; i<3; i++) {
+            // Tasks below the split hold one extra cell, see calcLocalStart(). Both
+            // candidates are computed and blended arithmetically, as a ternary would
+            // be turned back into a branch around the (potentially trapping) conversions.
+            large[i] = cell[i] < split[i];
+            const int64_t below = divide(cell[i], nPerTask[i] + 1, invPerTaskPlusOne[i]);
+            const int64_t above = remainder[i] + divide(cell[i] - split[i], nPerTask[i], invPerTask[i]);
+            const int64_t l = large[i];
+            const int64_t t = above + l * (below - above);
+            const int64_t start = t * nPerTask[i] + remainder[i] + l * (t - remainder[i]);
+            rank += t * rankStride[i];
+            offset[i] = cell[i] - start + ghostOffset[i];
+         }
+         // Blend the precomputed strides arithmetically rather than indexing by large[]
+         const int64_t l0 = large[0], l1 = large[1];
+         const int64_t rowCells = rowStorage[0] + l0 * (rowStorage[1] - rowStorage[0]);
+         const int64_t planeRowsSmall = planeStorage[0][0] + l1 * (planeStorage[0][1] - planeStorage[0][0]);
+         const int64_t planeRowsLarge = planeStorage[1][0] + l1 * (planeStorage[1][1] - planeStorage[1][0]);
+         const int64_t planeRows = planeRowsSmall + l0 * (planeRowsLarge - planeRowsSmall);
+         task = rank;
+         localID = offset[0] + rowCells * (offset[1] + planeRows * offset[2]);
+      }
 
-           if(status != MPI_SUCCESS) {
-             std::cerr << "Creating cartesian communicatior failed when attempting to create FsGrid!" << std::endl;
-             throw std::runtime_error("FSGrid communicator setup failed");
-           }
+      std::array<int64_t, 3> nPerTask;
+      std::array<int64_t, 3> remainder;
+      std::array<int64_t, 3> split; //!< First cell handled by a task without an extra remainder cell
+      std::array<double, 3> invPerTask;
+      std::array<double, 3> invPerTaskPlusOne;
+      std::array<int64_t, 3> ghostOffset; //!< Stencil width, or zero for collapsed dimensions
+      std::array<int64_t, 3> ghostWidth; //!< Total ghost cells in storage, zero for collapsed dimensions
+      std::array<bool, 3> collapsed;
+      int rowAlignment = 1; //!< Storage padding of the grid, see calcStorageSize()
+      int conflictStride = 0;
+      size_t cellBytes = 1;
+      std::array<int64_t, 3> globalCells;
+      std::array<double, 3> invGlobalCells;
+      std::array<int64_t, 3> rankStride;
+      std::array<int64_t, 2> rowStorage; //!< Storage row length of tasks without and with an extra x cell
+      std::array<std::array<int64_t, 2>, 2> planeStorage; //!< Storage rows per plane, by extra x cell and extra y cell
+};
 
-           status = MPI_Comm_rank(comm3d, &rank);
-           if(status != MPI_SUCCESS) {
-              std::cerr << "Getting rank failed when attempting to create FsGrid!" << std::endl;
-  
-              // Without a rank, there's really not much we can do. Just return an uninitialized grid
-              // (I suppose we'll crash after this, anyway)
-              return;
-           }
-  
-           // Determine our position in the resulting task-grid
-           status = MPI_Cart_coords(comm3d, rank, 3, taskPosition.data());
-           if(status != MPI_SUCCESS) {
-              std::cerr << "Rank " << rank
-                 << " unable to determine own position in cartesian communicator when attempting to create FsGrid!"
-                 << std::endl;
-           }
+/*! Lightweight, non-owning view of an FsGrid's local storage for use in solver kernels.
+ *
+ * Holds a pointer to local cell (0,0,0) and the storage strides, so that accessing a
+ * cell is pure pointer arithmetic without bounds checks or neighbour lookups.
+ * Collapsed dimensions have a stride of zero. Ghost cells are reachable with
+ * coordinates in [-stencil, localSize+stencil[, but unlike FsGrid::get() no periodic
+ * remapping is done, so ghosts have to be up to date.
+ * Compiling with FSGRID_DEBUG enables bounds checking.
+ */
+template <typename T> class FsGridView : public FsGridTools {
+   public:
+
+      //! A single cell of the view, with access to its neighbours
+      struct Cell {
+         T* centre;
+         std::array<LocalID, 3> stride;
+#ifdef FSGRID_DEBUG
+         // Position of the cell and extent of its view, for bounds checking of neighbours
+         std::array<int, 3> position = {0, 0, 0};
+         std::array<FsIndex_t, 3> localSize = {0, 0, 0};
+         int stencil = 0;
+#endif
+
+         //! Access the neighbour at the given offset from this cell
+         T& at(int dx, int dy, int dz) const {
+#ifdef FSGRID_DEBUG
+            checkBounds(position[0] + dx, position[1] + dy, position[2] + dz, stride, localSize, stencil);
+#endif
+            return centre[dx * stride[0] + dy * stride[1] + dz * stride[2]];
          }
+         T& operator*() const { return *centre; }
+         T* operator->() const { return centre; }
+      };
 
-         // Create a temporary aux subcommunicator for the (Aux) MPI_Cart_create
-         int colorAux = (parentRank > (parentSize - 1) % size) ? (parentRank - (parentSize % size)) / size : MPI_UNDEFINED;
-         MPI_Comm_split(parent_comm, colorAux, parentRank, &comm1d_aux);
+      FsGridView() = default;
 
-         int rankAux;
-         std::array<int, 3> taskPositionAux;
+      /*! \param origin Pointer to local cell (0,0,0)
+       * \param stride Storage strides, in cells, zero for collapsed dimensions
+       * \param localSize Size of the local domain, without ghost cells
+       * \param stencil Ghost cell width
+       */
+      FsGridView(T* origin, const std::array<LocalID, 3>& stride, const std::array<FsIndex_t, 3>& localSize, int stencil) :
+         origin(origin), stride(stride), localSize(localSize), stencil(stencil) {}
 
-         if(colorAux != MPI_UNDEFINED){
-           // Create an aux cartesian communicator corresponding to the comm3d (but shidted).
-           status = MPI_Cart_create(comm1d_aux, 3, ntasksPerDim.data(), isPeriodicInt.data(), 0, &comm3d_aux);
-           if(status != MPI_SUCCESS) {
-             std::cerr << "Creating cartesian communicatior failed when attempting to create FsGrid!" << std::endl;
-             throw std::runtime_error("FSGrid communicator setup failed");
-           }
-           status = MPI_Comm_rank(comm3d_aux, &rankAux);
-           if(status != MPI_SUCCESS) {
-             std::cerr << "Getting rank failed when attempting to create FsGrid!" << std::endl;
-             return;
-           }
-           // Determine our position in the resulting task-grid
-           status = MPI_Cart_coords(comm3d_aux, rankAux, 3, taskPositionAux.data());
-           if(status != MPI_SUCCESS) {
-           std::cerr << "Rank " << rankAux
-               << " unable to determine own position in cartesian communicator when attempting to create FsGrid!"
-               << std::endl;
-           }
-         }
+      //! Access the cell at the given task-local coordinates
+      T& operator()(int x, int y, int z) const {
+#ifdef FSGRID_DEBUG
+         checkBounds(x, y, z, stride, localSize, stencil);
+#endif
+         return origin[x * stride[0] + y * stride[1] + z * stride[2]];
+      }
 
+      //! Get the cell at the given task-local coordinates, for neighbour access
+      Cell cell(int x, int y, int z) const {
 #ifdef FSGRID_DEBUG
-         // All FS ranks send their true comm3d rank and taskPosition data to dest
-         MPI_Request *request = new MPI_Request[(parentSize - 1) / size * 2 + 2];
-         for(int i = 0; i < (parentSize - 1) / size; i++){
-            int dest = (colorFs != MPI_UNDEFINED) ? parentRank + i * size + (parentSize - 1) 
-               % size + 1 : MPI_PROC_NULL;
-            if(dest >= parentSize) 
-               dest = MPI_PROC_NULL;
-            MPI_Isend(&rank, 1, MPI_INT, dest, 9274, parent_comm, &request[2 * i]);
-            MPI_Isend(taskPosition.data(), 3, MPI_INT, dest, 9275, parent_comm, &request[2 * i + 1]);
-         }
+         return Cell{&(*this)(x, y, z), stride, {x, y, z}, localSize, stencil};
+#else
+         return Cell{&(*this)(x, y, z), stride};
+#endif
+      }
 
-         // All Aux ranks receive the true comm3d rank and taskPosition data from 
-         // source and then compare that it matches their aux data
-         std::array<int, 3> taskPositionRecv;
-         int rankRecv;
-         int source = (colorAux != MPI_UNDEFINED) ? parentRank - (parentRank - 
-            (parentSize % size)) / size * size - parentSize % size : MPI_PROC_NULL;
+      //! Offset in cells between a cell and its neighbour at (dx, dy, dz)
+      LocalID offset(int dx, int dy, int dz) const {
+         return dx * stride[0] + dy * stride[1] + dz * stride[2];
+      }
 
-         MPI_Irecv(&rankRecv, 1, MPI_INT, source, 9274, parent_comm, &request[(parentSize - 1) / size * 2]);
-         MPI_Irecv(taskPositionRecv.data(), 3, MPI_INT, source, 9275, parent_comm, 
-            &request[(parentSize - 1) / size * 2 + 1]);
-         MPI_Waitall((parentSize - 1) / size * 2 + 2, request, MPI_STATUS_IGNORE);
+      const std::array<LocalID, 3>& getStride() const { return stride; }
+      const std::array<FsIndex_t, 3>& getLocalSize() const { return localSize; }
 
-         if(colorAux != MPI_UNDEFINED){
-            if(rankRecv != rankAux ||
-                 taskPositionRecv[0] != taskPositionAux[0] ||
-                    taskPositionRecv[1] != taskPositionAux[1] ||
-                       taskPositionRecv[2] != taskPositionAux[2]){
-               std::cerr << "Rank: " << parentRank
-                 << ". Aux cartesian communicator 'comm3d_aux' does not match with 'comm3d' !" << std::endl;
-               throw std::runtime_error("FSGrid aux communicator setup failed.");    
+   private:
+#ifdef FSGRID_DEBUG
+      static void checkBounds(int x, int y, int z, const std::array<LocalID, 3>& stride,
+            const std::array<FsIndex_t, 3>& localSize, int stencil) {
+         const int coords[3] = {x, y, z};
+         for(int i=0; i<3; i++) {
+            const int ghosts = stride[i] == 0 ? 0 : stencil;
+            if(coords[i] < -ghosts || coords[i] >= localSize[i] + ghosts) {
+               std::cerr << "Out-of bounds access in FsGridView: coordinate " << i << " = " << coords[i]
+                  << " is outside of [ " << -ghosts << ", " << localSize[i] + ghosts << "[!" << std::endl;
+               throw std::runtime_error("FsGridView out-of-bounds access");
             }
          }
-         delete[] request;
-#endif // FSGRID_DEBUG
+      }
+#endif
 
-         // Set correct task position for non-FS ranks
-         if(colorFs == MPI_UNDEFINED){
-            for(int i=0; i<3; i++){
-               taskPosition[i] = taskPositionAux[i];
-            }
-         }
+      T* origin = nullptr;
+      std::array<LocalID, 3> stride = {0, 0, 0};
+      std::array<FsIndex_t, 3> localSize = {0, 0, 0};
+      int stencil = 0;
+};
 
-         // Determine size of our local grid
+/*! Unchecked view of a single component of an FsGrid stored with FsGridLayoutAoSoA.
+ * Like FsGridView, but each access maps the cell to its tile and lane. The W values of
+ * a tile are contiguous, and tiles start at x = -stencil + k*W in every row.
+ * \param Real Type of the component
+ * \param W Tile width of the layout
+ */
+template <typename Real, int W> class FsGridTiledView : public FsGridTools {
+   public:
+      FsGridTiledView() = default;
+
+      /*! \param base Pointer to the component's values of the first tile of storage
+       * \param origin LocalID of local cell (0,0,0)
+       * \param stride Storage strides, in cells, zero for collapsed dimensions
+       * \param components Number of components per cell
+       * \param localSize Size of the local domain, without ghost cells
+       * \param stencil Ghost cell width
+       */
+      FsGridTiledView(Real* base, LocalID origin, const std::array<LocalID, 3>& stride, int components,
+            const std::array<FsIndex_t, 3>& localSize, int stencil) :
+         base(base), origin(origin), stride(stride), tileStride(components * W), localSize(localSize), stencil(stencil) {}
+
+      //! Access the component of the cell at the given task-local coordinates
+      Real& operator()(int x, int y, int z) const {
+#ifdef FSGRID_DEBUG
+         const int coords[3] = {x, y, z};
          for(int i=0; i<3; i++) {
-            localSize[i] = calcLocalSize(globalSize[i],ntasksPerDim[i], taskPosition[i]);
-            localStart[i] = calcLocalStart(globalSize[i],ntasksPerDim[i], taskPosition[i]);
+            const int ghosts = stride[i] == 0 ? 0 : stencil;
+            if(coords[i] < -ghosts || coords[i] >= localSize[i] + ghosts) {
+               std::cerr << "Out-of bounds access in FsGridTiledView: coordinate " << i << " = " << coords[i]
+                  << " is outside of [ " << -ghosts << ", " << localSize[i] + ghosts << "[!" << std::endl;
+               throw std::runtime_error("FsGridTiledView out-of-bounds access");
+            }
          }
+#endif
+         const size_t id = origin + x * stride[0] + y * stride[1] + z * stride[2];
+         return base[id / W * tileStride + id % W];
+      }
 
-         if(  localSize[0] == 0 || (globalSize[0] > stencil && localSize[0] < stencil)
-           || localSize[1] == 0 || (globalSize[1] > stencil && localSize[1] < stencil)
-           || localSize[2] == 0 || (globalSize[2] > stencil && localSize[2] < stencil)) {
-            std::cerr << "FSGrid space partitioning leads to a space that is too small on Rank " << rank << "." <<std::endl;
-            std::cerr << "Please run with a different number of Tasks, so that space is better divisible." <<std::endl;
-            throw std::runtime_error("FSGrid too small domains");
-         }
+      /*! Pointer to the W contiguous values of the tile starting at the given cell.
+       * x has to be a tile start, i.e. x + stencil has to be a multiple of W.
+       * The next tile in x follows at an offset of getTileStride().
+       */
+      Real* tile(int x, int y, int z) const {
+         return &(*this)(x, y, z);
+      }
 
-         // NULL-initialize for all procs
-         neighbourSendType.fill(MPI_DATATYPE_NULL);
-         neighbourReceiveType.fill(MPI_DATATYPE_NULL);
+      //! Distance between the values of consecutive tiles
+      size_t getTileStride() const { return tileStride; }
 
-         // If non-FS process, set rank to -1 and localSize to zero and return
-         if(colorFs == MPI_UNDEFINED){
-            rank = -1;
-            localSize[0] = 0;
-            localSize[1] = 0;
-            localSize[2] = 0;
-            comm3d = comm3d_aux;
-            comm3d_aux = MPI_COMM_NULL;
-            return;
-         }
+      const std::array<LocalID, 3>& getStride() const { return stride; }
+      const std::array<FsIndex_t, 3>& getLocalSize() const { return localSize; }
 
-         // Allocate the array of neighbours
-         for(int i=0; i<size; i++) {
-            neighbour_index.push_back(MPI_PROC_NULL);
-         }
-         for(int i=0; i<27; i++) {
+   private:
+      Real* base = nullptr;
+      LocalID origin = 0;
+      std::array<LocalID, 3> stride = {0, 0, 0};
+      size_t tileStride = 0; //!< Distance between consecutive tiles, in values
+      std::array<FsIndex_t, 3> localSize = {0, 0, 0};
+      int stencil = 0;
+};
+
+/*! Component type and count of a cell, as needed by the storage layouts which
+ * split cells into their components. Specialise this for cell types other than std::array.
+ */
+template <typename T> struct FsGridCellTraits;
+
+template <typename Real, size_t N> struct FsGridCellTraits<std::array<Real, N>> {
+   typedef Real value_type;
+   static constexpr int components = N;
+};
+
+/*! Array-of-structs storage layout (the default): the data of each cell is contiguous. */
+struct FsGridLayoutAoS {
+   static constexpr bool cellsContiguous = true;
+   static constexpr bool tiled = false;
+   static constexpr int rowAlignment = 1; //!< Storage rows are padded to a multiple of this many cells
+   static constexpr int conflictStride = 0; //!< Row and plane strides that are a multiple of this many bytes get padded (0: never)
+   static constexpr bool fixedDimensions = false; //!< Whether collapsed dimensions are known at compile time (see FsGridLayoutDims)
+
+   //! Position of a cell component in storage, in units of components
+   static inline size_t offset(FsGridTools::LocalID id, int component, int components, size_t cells) {
+      return id * components + component;
+   }
+};
+
+/*! Struct-of-arrays storage layout: each component of the cells (for example each
+ * element of a std::array<Real,N>) is stored in its own contiguous array, so that
+ * kernels touching few components only stream those, with unit stride.
+ */
+struct FsGridLayoutSoA {
+   static constexpr bool cellsContiguous = false;
+   static constexpr bool tiled = false;
+   static constexpr int rowAlignment = 1;
+   static constexpr int conflictStride = 0;
+   static constexpr bool fixedDimensions = false;
+
+   //! Position of a cell component in storage, in units of components
+   static inline size_t offset(FsGridTools::LocalID id, int component, int components, size_t cells) {
+      return component * cells + id;
+   }
+};
+
+/*! Tiled (array-of-structs-of-arrays) storage layout: groups of W consecutive cells in x
+ * store each component as W contiguous values, followed by the next component.
+ * With W matched to the SIMD width, kernels get aligned vector loads per component while
+ * the components of a cell stay close together. Storage rows are padded to a multiple of W,
+ * so that the tiles of neighbouring rows line up.
+ * \param W Number of cells per tile, a power of two
+ */
+template <int W> struct FsGridLayoutAoSoA {
+   static_assert(W > 0 && (W & (W - 1)) == 0, "FsGridLayoutAoSoA tile width must be a power of two");
+   static constexpr bool cellsContiguous = false;
+   static constexpr bool tiled = true;
+   static constexpr int rowAlignment = W;
+   static constexpr int conflictStride = 0;
+   static constexpr bool fixedDimensions = false;
+   static constexpr int tileWidth = W;
+
+   //! Position of a cell component in storage, in units of components
+   static inline size_t offset(FsGridTools::LocalID id, int component, int components, size_t cells) {
+      return ((size_t)id / W * components + component) * W + (size_t)id % W;
+   }
+};
+
+/*! Padded variant of another storage layout. Storage rows and planes are padded so that their
+ * strides in bytes aren't a multiple of Stride: when the local domain plus ghost cells is a multiple
+ * of a large power of two, stencil accesses to neighbouring rows and planes would otherwise map to
+ * the same cache sets and evict each other.
+ * \param Base Layout to pad, FsGridLayoutAoS by default
+ * \param Stride Conflict stride in bytes, a power of two (L1 caches index sets with the address modulo 4 KiB)
+ */
+template <typename Base = FsGridLayoutAoS, int Stride = 4096> struct FsGridLayoutPadded : Base {
+   static_assert(Stride > 0 && (Stride & (Stride - 1)) == 0, "FsGridLayoutPadded stride must be a power of two");
+   static constexpr int conflictStride = Stride;
+};
+
+/*! Variant of another storage layout with the grid's dimensionality fixed at compile time.
+ * Grids otherwise detect collapsed dimensions (global size 1) at runtime; with this, cell
+ * indexing and get() compile without the collapsed dimensions, and ghost exchanges only
+ * loop over the 8 (2D) or 2 (1D) neighbour directions that exist. The global size given
+ * to the grid has to match.
+ * \param X,Y,Z Whether the grid extends in each dimension, false for a collapsed one
+ * \param Base Layout of the cells, FsGridLayoutAoS by default
+ */
+template <bool X, bool Y, bool Z, typename Base = FsGridLayoutAoS> struct FsGridLayoutDims : Base {
+   static constexpr bool fixedDimensions = true;
+   static constexpr std::array<bool, 3> extends = {X, Y, Z};
+};
+
+//! Layout of 2D grids in the xy-plane
+template <typename Base = FsGridLayoutAoS> using FsGridLayout2D = FsGridLayoutDims<true, true, false, Base>;
+//! Layout of 1D grids along x
+template <typename Base = FsGridLayoutAoS> using FsGridLayout1D = FsGridLayoutDims<true, false, false, Base>;
+
+/*! Reference to a cell of an FsGrid whose storage layout splits the cell into its components.
+ * Behaves like a reference to the cell's std::array: it can be indexed, read into
+ * and assigned from a T.
+ */
+template <typename T, typename Layout> class FsGridCellRef {
+   public:
+      typedef typename FsGridCellTraits<T>::value_type value_type;
+      static constexpr int components = FsGridCellTraits<T>::components;
+
+      FsGridCellRef(value_type* base, FsGridTools::LocalID id, size_t cells) : base(base), id(id), cells(cells) {}
+      FsGridCellRef(const FsGridCellRef& other) = default;
+
+      value_type& operator[](int component) const {
+         return base[Layout::offset(id, component, components, cells)];
+      }
+
+      value_type& at(int component) const {
+         if(component < 0 || component >= components) {
+            throw std::out_of_range("FsGridCellRef::at");
+         }
+         return (*this)[component];
+      }
+
+      constexpr size_t size() const {
+         return components;
+      }
+
+      operator T() const {
+         T value;
+         for(int c=0; c<components; c++) {
+            value[c] = (*this)[c];
+         }
+         return value;
+      }
+
+      FsGridCellRef& operator=(const T& value) {
+         for(int c=0; c<components; c++) {
+            (*this)[c] = value[c];
+         }
+         return *this;
+      }
+
+      // Assignment copies the referenced cell's contents, as with a real reference
+      FsGridCellRef& operator=(const FsGridCellRef& other) {
+         return *this = T(other);
+      }
+
+   private:
+      template <typename, typename> friend class FsGridCellPointer;
+      value_type* base;
+      FsGridTools::LocalID id;
+      size_t cells;
+};
+
+/*! Pointer to a cell of an FsGrid whose storage layout splits the cell into its components.
+ * This is what FsGrid::get() returns for such layouts, so that code written for T* keeps working.
+ */
+template <typename T, typename Layout> class FsGridCellPointer {
+   public:
+      FsGridCellPointer(std::nullptr_t = nullptr) : ref(nullptr, 0, 0) {}
+      FsGridCellPointer(typename FsGridCellRef<T, Layout>::value_type* base, FsGridTools::LocalID id, size_t cells) :
+         ref(base, id, cells) {}
+
+      FsGridCellRef<T, Layout> operator*() const { return ref; }
+      const FsGridCellRef<T, Layout>* operator->() const { return &ref; }
+
+      explicit operator bool() const { return ref.base != nullptr; }
+      bool operator==(std::nullptr_t) const { return ref.base == nullptr; }
+      bool operator!=(std::nullptr_t) const { return ref.base != nullptr; }
+
+   private:
+      FsGridCellRef<T, Layout> ref;
+};
+
+/*! Allocator for FsGrid's cell storage.
+ *
+ * Memory is aligned to cache lines, or, if the environment variable FSGRID_HUGEPAGES is set,
+ * large allocations are aligned to (transparent) huge pages and marked for huge page backing
+ * (the latter with FSGRID_USE_POSIX). Cells are only default-initialised, so that the grid can initialise them in parallel
+ * (first touch) and pages end up on the NUMA node of the threads working on them.
+ */
+template <typename T> struct FsGridAllocator {
+   typedef T value_type;
+   static constexpr size_t alignment = 64;
+   static constexpr size_t hugePageSize = 2 << 20;
+
+   FsGridAllocator() = default;
+   template <typename U> FsGridAllocator(const FsGridAllocator<U>&) {}
+
+   T* allocate(size_t n) {
+      const size_t bytes = n * sizeof(T);
+      const bool huge = bytes >= hugePageSize && getenv("FSGRID_HUGEPAGES") != NULL;
+      const size_t align = huge ? hugePageSize : alignment;
+      const size_t paddedBytes = (bytes + align - 1) / align * align;
+      void* p = aligned_alloc(align, paddedBytes);
+      if(p == NULL) {
+         throw std::bad_alloc();
+      }
+#ifdef MADV_HUGEPAGE
+      if(huge) {
+         madvise(p, paddedBytes, MADV_HUGEPAGE);
+      }
+#endif
+      return static_cast<T*>(p);
+   }
+
+   void deallocate(T* p, size_t) {
+      free(p);
+   }
+
+   //! Default-initialise instead of value-initialise, see above
+   template <typename U> void construct(U* p) {
+      ::new((void*)p) U;
+   }
+   template <typename U, typename... Args> void construct(U* p, Args&&... args) {
+      ::new((void*)p) U(std::forward<Args>(args)...);
+   }
+
+   template <typename U> bool operator==(const FsGridAllocator<U>&) const { return true; }
+   template <typename U> bool operator!=(const FsGridAllocator<U>&) const { return false; }
+};
+
+/*! Whether an allocator only default-initialises cells, like FsGridAllocator, so that FsGrid has
+ * to initialise its storage itself (in parallel). Other allocators value-initialise the cells when
+ * the storage vector is resized, and FsGrid leaves them at that. Specialise this for other
+ * default-initialising allocators.
+ */
+template <typename Allocator> struct FsGridDefaultInitialising : std::false_type {};
+template <typename T> struct FsGridDefaultInitialising<FsGridAllocator<T>> : std::true_type {};
+
+/*! Memory region shared by the storage of many grids.
+ *
+ * The arena reserves one block up front and hands out aligned pieces of it by bumping an
+ * offset, so that grids built in it (see the FsGrid constructor taking an arena) need no
+ * heap allocation of their own, and the memory footprint is known exactly. Allocations are
+ * released in bulk, either all at once with reset() or back to a previous mark(), which
+ * suits temporary grids. Grids using released memory must not be accessed any more.
+ * The arena itself doesn't touch the memory, so the grids still initialise it by first touch.
+ * It is not thread safe.
+ */
+class FsGridArena {
+   public:
+      static constexpr size_t alignment = 64;
+      static constexpr size_t hugePageSize = 2 << 20;
+
+      /*! Reserve the region.
+       * \param capacity Size of the region in bytes
+       * \param hugePages Align the region to huge pages and mark it for huge page backing (with FSGRID_USE_POSIX)
+       */
+      FsGridArena(size_t capacity, bool hugePages = false) {
+         const size_t align = hugePages ? hugePageSize : alignment;
+         this->capacity = (capacity + align - 1) / align * align;
+         base = static_cast<char*>(aligned_alloc(align, this->capacity));
+         if(base == NULL) {
+            std::cerr << "FsGridArena: could not reserve " << this->capacity << " bytes." << std::endl;
+            throw std::bad_alloc();
+         }
+#ifdef MADV_HUGEPAGE
+         if(hugePages) {
+            madvise(base, this->capacity, MADV_HUGEPAGE);
+         }
+#endif
+      }
+
+      FsGridArena(const FsGridArena&) = delete;
+      FsGridArena& operator=(const FsGridArena&) = delete;
+
+      ~FsGridArena() {
+         free(base);
+      }
+
+      //! Bytes an allocation of the given number of T's takes in the arena, to size it
+      template <typename T> static size_t footprint(size_t n) {
+         return (n * sizeof(T) + alignment - 1) / alignment * alignment;
+      }
+
+      //! Carve storage for n T's out of the arena. The T's are not constructed.
+      template <typename T> T* allocate(size_t n) {
+         static_assert(alignof(T) <= alignment, "FsGridArena: type is over-aligned");
+         const size_t bytes = footprint<T>(n);
+         if(bytes > capacity - used) {
+            std::cerr << "FsGridArena: " << bytes << " bytes requested, but only " << capacity - used
+               << " of " << capacity << " bytes are left." << std::endl;
+            throw std::bad_alloc();
+         }
+         T* p = reinterpret_cast<T*>(base + used);
+         used += bytes;
+         peak = std::max(peak, used);
+         return p;
+      }
+
+      //! Current allocation state, to pass to release()
+      size_t mark() const {
+         return used;
+      }
+
+      //! Release everything allocated after the given mark()
+      void release(size_t mark) {
+         used = std::min(mark, used);
+      }
+
+      //! Release everything
+      void reset() {
+         used = 0;
+      }
+
+      size_t getCapacity() const {
+         return capacity;
+      }
+      //! Bytes currently allocated
+      size_t getUsed() const {
+         return used;
+      }
+      //! Maximum of bytes allocated at any time
+      size_t getPeak() const {
+         return peak;
+      }
+
+   private:
+      char* base = nullptr;
+      size_t capacity = 0;
+      size_t used = 0;
+      size_t peak = 0;
+};
+
+/*! Default parallel backend of FsGrid's cell iteration functions.
+ * Distributes the work items over OpenMP threads with a static schedule
+ * (or runs them serially if compiled without OpenMP).
+ */
+struct FsGridOpenMP {
+   template<typename F> void parallelFor(size_t n, F&& func) const {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(size_t i=0; i<n; i++) {
+         func(i);
+      }
+   }
+};
+
+/*! Serial backend for FsGrid's cell iteration functions, e.g. for use inside
+ * an already threaded region.
+ */
+struct FsGridSerial {
+   template<typename F> void parallelFor(size_t n, F&& func) const {
+      for(size_t i=0; i<n; i++) {
+         func(i);
+      }
+   }
+};
+
+/*! Persistent thread pool backend for FsGrid's cell iteration functions, for codes
+ * not using OpenMP. Work items are split into contiguous, equally sized blocks, one per
+ * thread, just like OpenMP's static schedule. The calling thread works on the first
+ * block. A pool can only run one parallelFor() at a time.
+ */
+class FsGridThreadPool {
+   public:
+      explicit FsGridThreadPool(int nThreads = std::thread::hardware_concurrency()) {
+         nThreads = std::max(nThreads, 1);
+         for(int i=1; i<nThreads; i++) {
+            workers.emplace_back(&FsGridThreadPool::work, this, i);
+         }
+      }
+
+      ~FsGridThreadPool() {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+         }
+         wake.notify_all();
+         for(auto& w : workers) {
+            w.join();
+         }
+      }
+
+      FsGridThreadPool(const FsGridThreadPool&) = delete;
+      FsGridThreadPool& operator=(const FsGridThreadPool&) = delete;
+
+      int getNumThreads() const {
+         return workers.size() + 1;
+      }
+
+      template<typename F> void parallelFor(size_t n, F&& func) {
+         const size_t nThreads = getNumThreads();
+         std::function<void(int)> block = [n, nThreads, &func](int thread) {
+            const size_t end = n * (thread + 1) / nThreads;
+            for(size_t i = n * thread / nThreads; i < end; i++) {
+               func(i);
+            }
+         };
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &block;
+            pending = workers.size();
+            generation++;
+         }
+         wake.notify_all();
+         block(0);
+         std::unique_lock<std::mutex> lock(mutex);
+         finished.wait(lock, [this]{ return pending == 0; });
+         job = nullptr;
+      }
+
+   private:
+      void work(int thread) {
+         uint64_t seen = 0;
+         std::unique_lock<std::mutex> lock(mutex);
+         while(true) {
+            wake.wait(lock, [this, seen]{ return stop || generation != seen; });
+            if(stop) {
+               return;
+            }
+            seen = generation;
+            lock.unlock();
+            (*job)(thread);
+            lock.lock();
+            if(--pending == 0) {
+               finished.notify_one();
+            }
+         }
+      }
+
+      std::vector<std::thread> workers;
+      std::mutex mutex;
+      std::condition_variable wake;
+      std::condition_variable finished;
+      const std::function<void(int)>* job = nullptr;
+      uint64_t generation = 0;
+      size_t pending = 0;
+      bool stop = false;
+};
+
+/*! Domain decomposition and communicators of an FsGrid, which can be shared by any number of
+ * grids of the same global size and decomposition (whatever their cell type or layout).
+ * Building it is the collective, expensive part of creating a grid; grids constructed from
+ * an existing topology don't communicate at all. Ghost cell datatypes are cached here,
+ * so that grids of identical cell size and layout share them as well.
+ *
+ * Topologies are held through std::shared_ptr by the grids using them, and are finalized
+ * when the last user lets go of them. Like FsGrid, this has to happen before MPI_Finalize(),
+ * or finalize() has to be called explicitly.
+ */
+class FsGridTopology : public FsGridTools {
+   public:
+      //! Ghost cell datatypes for the 27 neighbour directions (self and collapsed directions are null)
+      struct GhostTypes {
+         std::array<MPI_Datatype, 27> send;
+         std::array<MPI_Datatype, 27> receive;
+      };
+
+      /*! Build the topology. This is collective over parent_comm.
+       * \param globalSize Cell size of the global simulation domain.
+       * \param parent_comm The MPI communicator the grids should use.
+       * \param isPeriodic An array specifying, for each dimension, whether it is to be treated as periodic.
+       * \param stencil Ghost cell width the decomposition has to leave room for
+       * \param decomposition Number of tasks in each dimension, or {0,0,0} to choose it automatically
+       */
+      FsGridTopology(std::array<FsSize_t,3> globalSize, MPI_Comm parent_comm, std::array<bool,3> isPeriodic,
+            int stencil, const std::array<Task_t, 3>& decomposition = {0,0,0}, bool verbose = false)
+            : globalSize(globalSize), stencil(stencil) {
+         int status;
+         int size;
+
+         // Spans FS and non-FS tasks alike, for results all of them need
+         MPI_Comm_dup(parent_comm, &comm_parent);
+
+         // Get parent_comm info
+         int parentRank;
+         MPI_Comm_rank(parent_comm, &parentRank);
+         int parentSize;
+         MPI_Comm_size(parent_comm, &parentSize);
+
+         // If environment variable FSGRID_PROCS is set, 
+         // use that for determining the number of FS-processes
+         size = parentSize;
+         if(getenv("FSGRID_PROCS") != NULL) {
+            const int fsgridProcs = atoi(getenv("FSGRID_PROCS"));
+            if(fsgridProcs > 0 && fsgridProcs < size)
+               size = fsgridProcs;
+         }
+
+         std::array<Task_t,3> emptyarr = {0,0,0};
+         if (decomposition == emptyarr){
+            // If decomposition isn't pre-defined, heuristically choose a good domain decomposition for our field size
+            computeDomainDecomposition(globalSize, size, ntasksPerDim, stencil, verbose);
+         } else {
+            ntasksPerDim = decomposition;
+            if (ntasksPerDim[0]*ntasksPerDim[1]*ntasksPerDim[2] != size){
+               std::cerr << "Given decomposition ("<<ntasksPerDim[0] << " " << ntasksPerDim[1] << " " << ntasksPerDim[2] << ") does not distribute to the number of tasks given" << std::endl;
+               throw std::runtime_error("Given decomposition does not distribute to the number of tasks given");
+            }
+            ntasksPerDim[0] = decomposition[0];
+            ntasksPerDim[1] = decomposition[1];
+            ntasksPerDim[2] = decomposition[2];
+         }
+         
+         //set private array
+         periodic = isPeriodic;
+         //set temporary int arrays for MPI_Cart_create
+         std::array<int, 3> isPeriodicInt, ntasksInt;
+         for(unsigned int i=0; i < isPeriodic.size(); i++) {
+            isPeriodicInt[i] = (int)isPeriodic[i];
+            ntasksInt[i] = (int)ntasksPerDim[i];
+         }  
+
+         // Create a temporary FS subcommunicator for the MPI_Cart_create
+         int colorFs = (parentRank < size) ? 1 : MPI_UNDEFINED;
+         MPI_Comm_split(parent_comm, colorFs, parentRank, &comm1d);
+
+         if(colorFs != MPI_UNDEFINED){
+           // Create cartesian communicator. Note, that reorder is false so
+           // ranks match the ones in parent_comm
+           status = MPI_Cart_create(comm1d, 3, ntasksPerDim.data(), isPeriodicInt.data(), 0, &comm3d);
+
+           if(status != MPI_SUCCESS) {
+             std::cerr << "Creating cartesian communicatior failed when attempting to create FsGrid!" << std::endl;
+             throw std::runtime_error("FSGrid communicator setup failed");
+           }
+
+           status = MPI_Comm_rank(comm3d, &rank);
+           if(status != MPI_SUCCESS) {
+              std::cerr << "Getting rank failed when attempting to create FsGrid!" << std::endl;
+  
+              // Without a rank, there's really not much we can do. Just return an uninitialized grid
+              // (I suppose we'll crash after this, anyway)
+              return;
+           }
+  
+           // Determine our position in the resulting task-grid
+           status = MPI_Cart_coords(comm3d, rank, 3, taskPosition.data());
+           if(status != MPI_SUCCESS) {
+              std::cerr << "Rank " << rank
+                 << " unable to determine own position in cartesian communicator when attempting to create FsGrid!"
+                 << std::endl;
+           }
+         }
+
+         // Create a temporary aux subcommunicator for the (Aux) MPI_Cart_create
+         int colorAux = (parentRank > (parentSize - 1) % size) ? (parentRank - (parentSize % size)) / size : MPI_UNDEFINED;
+         MPI_Comm_split(parent_comm, colorAux, parentRank, &comm1d_aux);
+
+         int rankAux;
+         std::array<int, 3> taskPositionAux;
+
+         if(colorAux != MPI_UNDEFINED){
+           // Create an aux cartesian communicator corresponding to the comm3d (but shidted).
+           status = MPI_Cart_create(comm1d_aux, 3, ntasksPerDim.data(), isPeriodicInt.data(), 0, &comm3d_aux);
+           if(status != MPI_SUCCESS) {
+             std::cerr << "Creating cartesian communicatior failed when attempting to create FsGrid!" << std::endl;
+             throw std::runtime_error("FSGrid communicator setup failed");
+           }
+           status = MPI_Comm_rank(comm3d_aux, &rankAux);
+           if(status != MPI_SUCCESS) {
+             std::cerr << "Getting rank failed when attempting to create FsGrid!" << std::endl;
+             return;
+           }
+           // Determine our position in the resulting task-grid
+           status = MPI_Cart_coords(comm3d_aux, rankAux, 3, taskPositionAux.data());
+           if(status != MPI_SUCCESS) {
+           std::cerr << "Rank " << rankAux
+               << " unable to determine own position in cartesian communicator when attempting to create FsGrid!"
+               << std::endl;
+           }
+         }
+
+#ifdef FSGRID_DEBUG
+         // All FS ranks send their true comm3d rank and taskPosition data to dest
+         MPI_Request *request = new MPI_Request[(parentSize - 1) / size * 2 + 2];
+         for(int i = 0; i < (parentSize - 1) / size; i++){
+            int dest = (colorFs != MPI_UNDEFINED) ? parentRank + i * size + (parentSize - 1) 
+               % size + 1 : MPI_PROC_NULL;
+            if(dest >= parentSize) 
+               dest = MPI_PROC_NULL;
+            MPI_Isend(&rank, 1, MPI_INT, dest, 9274, parent_comm, &request[2 * i]);
+            MPI_Isend(taskPosition.data(), 3, MPI_INT, dest, 9275, parent_comm, &request[2 * i + 1]);
+         }
+
+         // All Aux ranks receive the true comm3d rank and taskPosition data from 
+         // source and then compare that it matches their aux data
+         std::array<int, 3> taskPositionRecv;
+         int rankRecv;
+         int source = (colorAux != MPI_UNDEFINED) ? parentRank - (parentRank - 
+            (parentSize % size)) / size * size - parentSize % size : MPI_PROC_NULL;
+
+         MPI_Irecv(&rankRecv, 1, MPI_INT, source, 9274, parent_comm, &request[(parentSize - 1) / size * 2]);
+         MPI_Irecv(taskPositionRecv.data(), 3, MPI_INT, source, 9275, parent_comm, 
+            &request[(parentSize - 1) / size * 2 + 1]);
+         MPI_Waitall((parentSize - 1) / size * 2 + 2, request, MPI_STATUS_IGNORE);
+
+         if(colorAux != MPI_UNDEFINED){
+            if(rankRecv != rankAux ||
+                 taskPositionRecv[0] != taskPositionAux[0] ||
+                    taskPositionRecv[1] != taskPositionAux[1] ||
+                       taskPositionRecv[2] != taskPositionAux[2]){
+               std::cerr << "Rank: " << parentRank
+                 << ". Aux cartesian communicator 'comm3d_aux' does not match with 'comm3d' !" << std::endl;
+               throw std::runtime_error("FSGrid aux communicator setup failed.");    
+            }
+         }
+         delete[] request;
+#endif // FSGRID_DEBUG
+
+         // Set correct task position for non-FS ranks
+         if(colorFs == MPI_UNDEFINED){
+            for(int i=0; i<3; i++){
+               taskPosition[i] = taskPositionAux[i];
+            }
+         }
+
+         // Determine size of our local grid
+         for(int i=0; i<3; i++) {
+            localSize[i] = calcLocalSize(globalSize[i],ntasksPerDim[i], taskPosition[i]);
+            localStart[i] = calcLocalStart(globalSize[i],ntasksPerDim[i], taskPosition[i]);
+         }
+
+         if(  localSize[0] == 0 || (globalSize[0] > (FsSize_t)stencil && localSize[0] < stencil)
+           || localSize[1] == 0 || (globalSize[1] > (FsSize_t)stencil && localSize[1] < stencil)
+           || localSize[2] == 0 || (globalSize[2] > (FsSize_t)stencil && localSize[2] < stencil)) {
+            std::cerr << "FSGrid space partitioning leads to a space that is too small on Rank " << rank << "." <<std::endl;
+            std::cerr << "Please run with a different number of Tasks, so that space is better divisible." <<std::endl;
+            throw std::runtime_error("FSGrid too small domains");
+         }
+
+         for(int i=0; i<27; i++) {
             neighbour[i]=MPI_PROC_NULL;
          }
 
-         // Get the IDs of the 26 direct neighbours
-         for(int x=-1; x<=1;x++) {
-            for(int y=-1; y<=1;y++) {
-               for(int z=-1; z<=1; z++) {
-                  std::array<Task_t,3> neighPosition;
+         // If non-FS process, set rank to -1 and localSize to zero and return
+         if(colorFs == MPI_UNDEFINED){
+            rank = -1;
+            localSize[0] = 0;
+            localSize[1] = 0;
+            localSize[2] = 0;
+            comm3d = comm3d_aux;
+            comm3d_aux = MPI_COMM_NULL;
+            return;
+         }
+
+         // Get the IDs of the 26 direct neighbours
+         for(int x=-1; x<=1;x++) {
+            for(int y=-1; y<=1;y++) {
+               for(int z=-1; z<=1; z++) {
+                  std::array<Task_t,3> neighPosition;
+
+                  /*
+                   * Figure out the coordinates of the neighbours in all three
+                   * directions
+                   */
+                  neighPosition[0]=taskPosition[0]+x;
+                  if(isPeriodic[0]) {
+                     neighPosition[0] += ntasksPerDim[0];
+                     neighPosition[0] %= ntasksPerDim[0];
+                  }
+
+                  neighPosition[1]=taskPosition[1]+y;
+                  if(isPeriodic[1]) {
+                     neighPosition[1] += ntasksPerDim[1];
+                     neighPosition[1] %= ntasksPerDim[1];
+                  }
+
+                  neighPosition[2]=taskPosition[2]+z;
+                  if(isPeriodic[2]) {
+                     neighPosition[2] += ntasksPerDim[2];
+                     neighPosition[2] %= ntasksPerDim[2];
+                  }
+
+                  /*
+                   * If those coordinates exist, figure out the responsible CPU
+                   * and store its rank
+                   */
+                  if(neighPosition[0]>=0 && neighPosition[0]<ntasksPerDim[0] && neighPosition[1]>=0
+                        && neighPosition[1]<ntasksPerDim[1] && neighPosition[2]>=0 && neighPosition[2]<ntasksPerDim[2]) {
+
+                     // Calculate the rank
+                     int neighRank;
+                     status = MPI_Cart_rank(comm3d, neighPosition.data(), &neighRank);
+                     if(status != MPI_SUCCESS) {
+                        std::cerr << "Rank " << rank << " can't determine neighbour rank at position [";
+                        for(int i=0; i<3; i++) {
+                           std::cerr << neighPosition[i] << ", ";
+                        }
+                        std::cerr << "]" << std::endl;
+                     }
+
+                     neighbour[(x+1)*9+(y+1)*3+(z+1)]=neighRank;
+                  } else {
+                     neighbour[(x+1)*9+(y+1)*3+(z+1)]=MPI_PROC_NULL;
+                  }
+               }
+            }
+         }
+      }
+
+      FsGridTopology(const FsGridTopology&) = delete;
+      FsGridTopology& operator=(const FsGridTopology&) = delete;
+
+      ~FsGridTopology() {
+         finalize();
+      }
+
+      //! Free the communicators and all cached datatypes
+      void finalize() noexcept {
+         for(auto& entry : ghostTypeCache) {
+            for(auto* types : {&entry.second.send, &entry.second.receive}) {
+               for(auto& type : *types) {
+                  if(type != MPI_DATATYPE_NULL) {
+                     MPI_Type_free(&type);
+                  }
+               }
+            }
+         }
+         ghostTypeCache.clear();
+         for(auto& entry : reductionCache) {
+            MPI_Op_free(&entry.second.second);
+            MPI_Type_free(&entry.second.first);
+         }
+         reductionCache.clear();
+         for(MPI_Comm* comm : {&comm3d, &comm3d_aux, &comm1d, &comm1d_aux, &comm_parent}) {
+            if(*comm != MPI_COMM_NULL) {
+               MPI_Comm_free(comm);
+               *comm = MPI_COMM_NULL;
+            }
+         }
+      }
+
+      //! The cartesian communicator (for non-FS tasks, the auxiliary one)
+      MPI_Comm getComm() const {
+         return comm3d;
+      }
+      //! A duplicate of the communicator the topology was built from, which also holds the non-FS tasks
+      MPI_Comm getParentComm() const {
+         return comm_parent;
+      }
+      //! This task's rank in getComm(), -1 for non-FS tasks
+      int getRank() const {
+         return rank;
+      }
+      int getStencil() const {
+         return stencil;
+      }
+      const std::array<FsSize_t, 3>& getGlobalSize() const {
+         return globalSize;
+      }
+      const std::array<Task_t, 3>& getDecomposition() const {
+         return ntasksPerDim;
+      }
+      const std::array<Task_t, 3>& getTaskPosition() const {
+         return taskPosition;
+      }
+      const std::array<bool, 3>& getPeriodic() const {
+         return periodic;
+      }
+      const std::array<FsIndex_t, 3>& getLocalSize() const {
+         return localSize;
+      }
+      const std::array<FsIndex_t, 3>& getLocalStart() const {
+         return localStart;
+      }
+      //! Ranks of the 26 neighbours (and ourselves), indexed by (x+1)*9+(y+1)*3+(z+1)
+      const std::array<int, 27>& getNeighbours() const {
+         return neighbour;
+      }
+
+      /*! Index into getNeighbours() of a task, or -1 if it isn't a neighbour of this one.
+       * If several directions lead to the same task (for periodic dimensions of one or two tasks),
+       * one of them is returned.
+       */
+      int getNeighbourIndex(int task) const {
+         if(rank == -1 || task < 0 || task >= ntasksPerDim[0] * ntasksPerDim[1] * ntasksPerDim[2]) {
+            return -1;
+         }
+         // Ranks are laid out in row-major order, as the communicator is created without reordering
+         const Task_t position[3] = {task / (ntasksPerDim[1] * ntasksPerDim[2]), task / ntasksPerDim[2] % ntasksPerDim[1],
+            task % ntasksPerDim[2]};
+         int index = 0;
+         for(int i=0; i<3; i++) {
+            int shift = position[i] - taskPosition[i];
+            if(periodic[i] && shift > 1) {
+               shift -= ntasksPerDim[i];
+            } else if(periodic[i] && shift < -1) {
+               shift += ntasksPerDim[i];
+            }
+            if(shift < -1 || shift > 1) {
+               return -1;
+            }
+            index = index * 3 + shift + 1;
+         }
+         return index;
+      }
+
+      /*! Ghost datatypes for the given key (describing the cell size and layout), created with
+       * build(send, receive) on first use. The types are committed and owned by the topology.
+       */
+      template<typename Build> const GhostTypes& getGhostTypes(const std::array<size_t, 7>& key, Build&& build) {
+         auto it = ghostTypeCache.find(key);
+         if(it == ghostTypeCache.end()) {
+            GhostTypes types;
+            types.send.fill(MPI_DATATYPE_NULL);
+            types.receive.fill(MPI_DATATYPE_NULL);
+            build(types.send, types.receive);
+            for(int i=0; i<27; i++) {
+               if(types.receive[i] != MPI_DATATYPE_NULL)
+                  MPI_Type_commit(&(types.receive[i]));
+               if(types.send[i] != MPI_DATATYPE_NULL)
+                  MPI_Type_commit(&(types.send[i]));
+            }
+            it = ghostTypeCache.emplace(key, types).first;
+         }
+         return it->second;
+      }
+
+      /*! Datatype of bytes-sized values and a non-commutative MPI operation combining them with
+       * function, created on first use. Both are committed and owned by the topology.
+       */
+      std::pair<MPI_Datatype, MPI_Op> getReductionOp(size_t bytes, MPI_User_function* function) {
+         const std::pair<size_t, MPI_User_function*> key(bytes, function);
+         auto it = reductionCache.find(key);
+         if(it == reductionCache.end()) {
+            std::pair<MPI_Datatype, MPI_Op> op;
+            MPI_Type_contiguous(bytes, MPI_BYTE, &op.first);
+            MPI_Type_commit(&op.first);
+            MPI_Op_create(function, 0, &op.second);
+            it = reductionCache.emplace(key, op).first;
+         }
+         return it->second;
+      }
+
+   private:
+      MPI_Comm comm1d = MPI_COMM_NULL;
+      MPI_Comm comm1d_aux = MPI_COMM_NULL;
+      MPI_Comm comm3d = MPI_COMM_NULL;
+      MPI_Comm comm3d_aux = MPI_COMM_NULL;
+      MPI_Comm comm_parent = MPI_COMM_NULL;
+      int rank = -1; //!< This task's rank in the communicator
+      std::array<int, 27> neighbour; //!< Tasks of the 26 neighbours (plus ourselves)
+      std::array<Task_t, 3> ntasksPerDim; //!< Number of tasks in each direction
+      std::array<Task_t, 3> taskPosition; //!< This task's position in the 3d task grid
+      std::array<bool, 3> periodic; //!< Information about whether a given direction is periodic
+      std::array<FsSize_t, 3> globalSize; //!< Global size of the simulation space, in cells
+      std::array<FsIndex_t, 3> localSize; //!< Local size of simulation space handled by this task (without ghost cells)
+      std::array<FsIndex_t, 3> localStart; //!< Offset of the local coordinate system against the global one
+      int stencil; //!< Ghost cell width the decomposition was made for
+      std::map<std::array<size_t, 7>, GhostTypes> ghostTypeCache;
+      std::map<std::pair<size_t, MPI_User_function*>, std::pair<MPI_Datatype, MPI_Op>> reductionCache;
+};
+
+/*! Header at the start of an FsGrid checkpoint file (see FsGrid::writeCheckpoint()).
+ * It is followed, at dataOffset, by the interior cells of the whole grid in global
+ * x-fastest order, each cell as the bytes of its T, whatever the grid's storage layout.
+ * Nothing in the file depends on the decomposition of the writing grid, so it can be
+ * read into a grid of the same size on any number of tasks.
+ */
+struct FsGridCheckpointHeader {
+   static constexpr char magicValue[8] = {'F', 'S', 'G', 'R', 'I', 'D', 'C', 'P'};
+   static constexpr uint32_t currentVersion = 1;
+
+   char magic[8]; //!< Always magicValue
+   uint32_t version; //!< Format version, currentVersion when written by this code
+   uint32_t cellBytes; //!< sizeof(T) of the written grid
+   uint64_t globalSize[3]; //!< Global size of the grid, in cells
+   double spacing[3]; //!< DX, DY and DZ of the grid
+   double physicalGlobalStart[3]; //!< Physical coordinates of the grid's first cell
+   uint64_t dataOffset; //!< Position of the first cell in the file, in bytes
+   uint8_t reserved[32]; //!< Zero, for future use
+
+   //! Whether the header was written by FsGrid in a format this code reads
+   bool valid() const {
+      return std::equal(magic, magic + 8, magicValue) && version == currentVersion;
+   }
+
+   /*! Read the header of a checkpoint file, for example to create a grid of matching size
+    * before restarting from it. Collective over comm; only its first task touches the file.
+    * Throws if the file can't be read or isn't an FsGrid checkpoint.
+    * \param path Name of the file
+    * \param comm Communicator of the tasks which need the header
+    */
+   static FsGridCheckpointHeader read(const std::string& path, MPI_Comm comm) {
+      FsGridCheckpointHeader header = {};
+      int rank;
+      MPI_Comm_rank(comm, &rank);
+      if(rank == 0) {
+         MPI_File file;
+         if(MPI_File_open(MPI_COMM_SELF, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) == MPI_SUCCESS) {
+            MPI_File_read_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+            MPI_File_close(&file);
+         }
+      }
+      MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, comm);
+      if(!header.valid()) {
+         if(rank == 0) {
+            std::cerr << "FsGrid can't read a checkpoint header from " << path << "." << std::endl;
+         }
+         throw std::runtime_error("FsGrid checkpoint header unreadable");
+      }
+      return header;
+   }
+};
+static_assert(sizeof(FsGridCheckpointHeader) == 128, "FsGridCheckpointHeader has to be 128 bytes");
+
+/*! Header at the start of a chunked FsGrid output file (see FsGrid::writeChunked() and
+ * FsGridChunkedReader). It is followed, at indexOffset, by numChunks FsGridChunkEntry
+ * records, which locate the chunk payloads. Each payload starts at a multiple of alignment
+ * bytes and holds the components of its box one after the other, each as an x-fastest
+ * array of the box's cells, so that every component of a chunk can be used in place
+ * (unless the chunk is compressed, see FsGridCodec).
+ */
+struct FsGridChunkedHeader {
+   static constexpr char magicValue[8] = {'F', 'S', 'G', 'R', 'I', 'D', 'C', 'K'};
+   static constexpr uint32_t currentVersion = 1;
+
+   char magic[8]; //!< Always magicValue
+   uint32_t version; //!< Format version, currentVersion when written by this code
+   uint32_t cellBytes; //!< sizeof(T) of the written grid
+   uint32_t components; //!< Number of components of a cell
+   uint32_t componentBytes; //!< Size of one component, in bytes
+   uint64_t globalSize[3]; //!< Global size of the grid, in cells
+   double spacing[3]; //!< DX, DY and DZ of the grid
+   double physicalGlobalStart[3]; //!< Physical coordinates of the grid's first cell
+   uint64_t numChunks; //!< Number of chunks, and of index entries
+   uint64_t indexOffset; //!< Position of the chunk index in the file, in bytes
+   uint64_t alignment; //!< Alignment of the chunk payloads in the file, in bytes
+   double quantum; //!< Quantisation step of chunks with codec 2
+
+   //! Whether the header was written by FsGrid in a format this code reads
+   bool valid() const {
+      return std::equal(magic, magic + 8, magicValue) && version == currentVersion;
+   }
+};
+static_assert(sizeof(FsGridChunkedHeader) == 128, "FsGridChunkedHeader has to be 128 bytes");
+
+//! Index entry of one chunk of a chunked FsGrid output file
+struct FsGridChunkEntry {
+   uint32_t start[3]; //!< Global coordinates of the chunk's first cell
+   uint32_t size[3]; //!< Size of the chunk's box, in cells
+   uint64_t offset; //!< Position of the payload in the file, in bytes
+   uint64_t bytes; //!< Size of the payload in the file, in bytes
+   uint32_t codec; //!< Encoding of the payload (see FsGridCodec), 0 for the plain component arrays
+   uint32_t reserved; //!< Zero, for future use
+
+   uint64_t cells() const {
+      return (uint64_t)size[0] * size[1] * size[2];
+   }
+};
+static_assert(sizeof(FsGridChunkEntry) == 48, "FsGridChunkEntry has to be 48 bytes");
+
+/*! Compression of the chunks of FsGrid::writeChunked().
+ * Lossless compression shuffles the bytes of the values, so that their slowly varying sign,
+ * exponent and high mantissa bytes end up next to each other, and then compresses them with a
+ * small LZ codec. Quantisation additionally rounds float or double values to multiples of
+ * 2*errorBound, so that every value is reproduced to within errorBound (plus the rounding
+ * error of the value type), and delta-encodes them along x before the lossless stage.
+ */
+struct FsGridCompression {
+   enum Codec : uint32_t {
+      none = 0, //!< Plain component arrays, usable in place
+      lossless = 1, //!< Byte shuffle and LZ
+      quantised = 2 //!< Quantisation, delta encoding, byte shuffle and LZ
+   };
+
+   Codec codec = none;
+   double errorBound = 0; //!< Largest absolute error of quantised values
+
+   static FsGridCompression losslessCompression() {
+      return {lossless, 0};
+   }
+   static FsGridCompression quantisedCompression(double errorBound) {
+      return {quantised, errorBound};
+   }
+};
+
+//! Encoders and decoders of the chunk payloads of chunked FsGrid files
+struct FsGridCodec {
+
+   /*! Encode the component arrays of a chunk, each into its own stream, so that readers can
+    * decode just the components they need. The payload starts with the byte counts of the
+    * streams (one uint64_t per component). Chunks which don't get smaller, and chunks which
+    * can't be quantised (non-finite or huge values), fall back to a simpler codec.
+    * \param values The chunk's components, one array of cells after the other
+    * \param cells Number of cells of the chunk
+    * \param components Number of components
+    * \param compression Requested compression
+    * \param out Encoded payload, unless none is returned
+    * \return Codec actually used
+    */
+   template<typename Real> static uint32_t encode(const Real* values, size_t cells, int components,
+         const FsGridCompression& compression, std::vector<char>& out) {
+      if(compression.codec == FsGridCompression::none) {
+         return FsGridCompression::none;
+      }
+      uint32_t codec = FsGridCompression::lossless;
+      std::vector<std::vector<uint64_t>> deltas;
+      if constexpr (std::is_floating_point<Real>::value) {
+         if(compression.codec == FsGridCompression::quantised && compression.errorBound > 0) {
+            const double quantum = 2 * compression.errorBound;
+            bool representable = true;
+            deltas.resize(components, std::vector<uint64_t>(cells));
+            for(int c=0; c<components && representable; c++) {
+               int64_t previous = 0;
+               for(size_t i=0; i<cells && representable; i++) {
+                  const double q = std::nearbyint(values[c * cells + i] / quantum);
+                  representable = std::abs(q) < 4.6e18; // Also false for NaN
+                  const int64_t current = representable ? (int64_t)q : 0;
+                  const int64_t delta = current - previous;
+                  deltas[c][i] = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63); // Zigzag, small magnitudes become small
+                  previous = current;
+               }
+            }
+            if(representable) {
+               codec = FsGridCompression::quantised;
+            }
+         }
+      }
+
+      out.assign(components * sizeof(uint64_t), 0);
+      std::vector<char> stream;
+      for(int c=0; c<components; c++) {
+         if(codec == FsGridCompression::quantised) {
+            pack(reinterpret_cast<const char*>(deltas[c].data()), cells, sizeof(uint64_t), stream);
+         } else {
+            pack(reinterpret_cast<const char*>(values + c * cells), cells, sizeof(Real), stream);
+         }
+         const uint64_t streamBytes = stream.size();
+         std::copy(reinterpret_cast<const char*>(&streamBytes), reinterpret_cast<const char*>(&streamBytes + 1),
+               out.data() + c * sizeof(uint64_t));
+         out.insert(out.end(), stream.begin(), stream.end());
+      }
+      if(codec == FsGridCompression::lossless && out.size() >= cells * components * sizeof(Real)) {
+         return FsGridCompression::none;
+      }
+      return codec;
+   }
+
+   /*! Decode some components of a chunk payload into plain component arrays.
+    * \param codec Codec of the payload
+    * \param in Encoded payload
+    * \param cells Number of cells of the chunk
+    * \param components Number of components of the chunk
+    * \param valueBytes Size of one value (4 or 8 for quantised payloads, which hold floats or doubles)
+    * \param quantum Quantisation step of quantised payloads
+    * \param firstComponent First component to decode
+    * \param numComponents Number of components to decode
+    * \param out Destination, numComponents arrays of cells values
+    */
+   static void decode(uint32_t codec, const char* in, size_t cells, int components, int valueBytes, double quantum,
+         int firstComponent, int numComponents, char* out) {
+      if(codec == FsGridCompression::none) {
+         std::copy(in + firstComponent * cells * valueBytes, in + (firstComponent + numComponents) * cells * valueBytes, out);
+         return;
+      }
+      if(codec != FsGridCompression::lossless && !(codec == FsGridCompression::quantised && (valueBytes == 4 || valueBytes == 8))) {
+         std::cerr << "FsGridCodec: unknown codec " << codec << " for " << valueBytes << " byte values." << std::endl;
+         throw std::runtime_error("FsGridCodec unknown codec");
+      }
+      std::vector<uint64_t> streamBytes(components);
+      std::copy(in, in + components * sizeof(uint64_t), reinterpret_cast<char*>(streamBytes.data()));
+      const char* stream = in + components * sizeof(uint64_t);
+      for(int c=0; c<firstComponent; c++) {
+         stream += streamBytes[c];
+      }
+      std::vector<uint64_t> deltas(codec == FsGridCompression::quantised ? cells : 0);
+      for(int c=firstComponent; c<firstComponent + numComponents; c++) {
+         char* values = out + (c - firstComponent) * cells * valueBytes;
+         if(codec == FsGridCompression::lossless) {
+            unpack(stream, streamBytes[c], cells, valueBytes, values);
+         } else {
+            unpack(stream, streamBytes[c], cells, sizeof(uint64_t), reinterpret_cast<char*>(deltas.data()));
+            int64_t current = 0;
+            for(size_t i=0; i<cells; i++) {
+               current += (int64_t)(deltas[i] >> 1) ^ -(int64_t)(deltas[i] & 1);
+               if(valueBytes == 4) {
+                  reinterpret_cast<float*>(values)[i] = current * quantum;
+               } else {
+                  reinterpret_cast<double*>(values)[i] = current * quantum;
+               }
+            }
+         }
+         stream += streamBytes[c];
+      }
+   }
+
+   private:
+      //! Byte shuffle and LZ-compress count values of valueBytes each
+      static void pack(const char* values, size_t count, int valueBytes, std::vector<char>& out) {
+         std::vector<uint8_t> shuffled(count * valueBytes);
+         for(int b=0; b<valueBytes; b++) {
+            for(size_t i=0; i<count; i++) {
+               shuffled[b * count + i] = values[i * valueBytes + b];
+            }
+         }
+         compress(shuffled.data(), shuffled.size(), out);
+      }
+
+      static void unpack(const char* in, size_t bytes, size_t count, int valueBytes, char* values) {
+         std::vector<uint8_t> shuffled(count * valueBytes);
+         decompress(reinterpret_cast<const uint8_t*>(in), bytes, shuffled.data(), shuffled.size());
+         for(int b=0; b<valueBytes; b++) {
+            for(size_t i=0; i<count; i++) {
+               values[i * valueBytes + b] = shuffled[b * count + i];
+            }
+         }
+      }
+
+      static void putLength(std::vector<char>& out, size_t length) {
+         for(; length >= 255; length -= 255) {
+            out.push_back((char)255);
+         }
+         out.push_back((char)length);
+      }
+
+      /*! LZ77 compression in the style of LZ4: sequences of a token (literal run length, match
+       * length - 4, 15 meaning that more length bytes follow), the literals, and a 16 bit match
+       * offset. Matches are found through a hash table of the last position of every 4 byte prefix.
+       */
+      static void compress(const uint8_t* in, size_t n, std::vector<char>& out) {
+         const int hashBits = 16;
+         std::vector<uint32_t> table(1 << hashBits, UINT32_MAX);
+         out.clear();
+         out.reserve(n + n / 255 + 16);
+         size_t literals = 0;
+         size_t i = 0;
+         size_t misses = 0;
+         auto emit = [&](size_t matchLength, size_t offset) {
+            const size_t literalLength = i - literals;
+            const size_t extra = matchLength > 0 ? matchLength - 4 : 0;
+            out.push_back((char)((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(extra, 15)));
+            if(literalLength >= 15) {
+               putLength(out, literalLength - 15);
+            }
+            out.insert(out.end(), in + literals, in + i);
+            if(matchLength > 0) {
+               out.push_back((char)(offset & 0xff));
+               out.push_back((char)(offset >> 8));
+               if(extra >= 15) {
+                  putLength(out, extra - 15);
+               }
+            }
+         };
+         while(i + 4 <= n) {
+            uint32_t prefix;
+            std::copy(in + i, in + i + 4, reinterpret_cast<uint8_t*>(&prefix));
+            const uint32_t hash = (prefix * 2654435761u) >> (32 - hashBits);
+            const uint32_t candidate = table[hash];
+            table[hash] = i;
+            if(candidate != UINT32_MAX && i - candidate <= 65535 && std::equal(in + candidate, in + candidate + 4, in + i)) {
+               size_t length = 4;
+               while(i + length < n && in[candidate + length] == in[i + length]) {
+                  length++;
+               }
+               emit(length, i - candidate);
+               i += length;
+               literals = i;
+               misses = 0;
+            } else {
+               // Skip faster through incompressible data, like LZ4's acceleration
+               i += 1 + (misses++ >> 5);
+            }
+         }
+         i = n;
+         emit(0, 0);
+      }
+
+      static void decompress(const uint8_t* in, size_t bytes, uint8_t* out, size_t n) {
+         const uint8_t* end = in + bytes;
+         size_t o = 0;
+         auto getLength = [&](size_t length) {
+            if(length == 15) {
+               uint8_t b;
+               do {
+                  b = in < end ? *in++ : 0;
+                  length += b;
+               } while(b == 255);
+            }
+            return length;
+         };
+         while(in < end) {
+            const uint8_t token = *in++;
+            const size_t literalLength = getLength(token >> 4);
+            if(literalLength > (size_t)(end - in) || o + literalLength > n) {
+               break;
+            }
+            std::copy(in, in + literalLength, out + o);
+            in += literalLength;
+            o += literalLength;
+            if(in + 2 > end) {
+               break;
+            }
+            const size_t offset = in[0] | (in[1] << 8);
+            in += 2;
+            const size_t matchLength = getLength(token & 15) + 4;
+            if(offset == 0 || offset > o || o + matchLength > n) {
+               break;
+            }
+            if(offset >= matchLength) {
+               std::copy(out + o - offset, out + o - offset + matchLength, out + o);
+               o += matchLength;
+            } else {
+               // Byte by byte, as the match overlaps its own output
+               for(size_t k=0; k<matchLength; k++, o++) {
+                  out[o] = out[o - offset];
+               }
+            }
+         }
+         if(o != n || in != end) {
+            std::cerr << "FsGridCodec: corrupt compressed data." << std::endl;
+            throw std::runtime_error("FsGridCodec corrupt data");
+         }
+      }
+};
+
+//! MPI-IO steps shared by the checkpoint writers and readers
+struct FsGridCheckpointIO : public FsGridTools {
+
+   //! Header for a checkpoint of the given grid geometry, with the cells right after it
+   static FsGridCheckpointHeader makeHeader(size_t cellBytes, const std::array<FsSize_t, 3>& globalSize,
+         const std::array<double, 3>& spacing, const std::array<double, 3>& physicalGlobalStart) {
+      FsGridCheckpointHeader header = {};
+      std::copy(FsGridCheckpointHeader::magicValue, FsGridCheckpointHeader::magicValue + 8, header.magic);
+      header.version = FsGridCheckpointHeader::currentVersion;
+      header.cellBytes = cellBytes;
+      for(int i=0; i<3; i++) {
+         header.globalSize[i] = globalSize[i];
+         header.spacing[i] = spacing[i];
+         header.physicalGlobalStart[i] = physicalGlobalStart[i];
+      }
+      header.dataOffset = sizeof(FsGridCheckpointHeader);
+      return header;
+   }
+
+   //! Open a checkpoint file collectively over comm, with collective buffering enabled
+   static MPI_File open(const std::string& path, int mode, MPI_Comm comm) {
+      MPI_Info info;
+      MPI_Info_create(&info);
+      MPI_Info_set(info, "romio_cb_write", "enable");
+      MPI_Info_set(info, "romio_cb_read", "enable");
+      MPI_File file;
+      const int status = MPI_File_open(comm, path.c_str(), mode, info, &file);
+      MPI_Info_free(&info);
+      if(status != MPI_SUCCESS) {
+         int rank;
+         MPI_Comm_rank(comm, &rank);
+         std::cerr << "FsGrid can't open checkpoint file " << path << " on rank " << rank << "." << std::endl;
+         throw std::runtime_error("FsGrid checkpoint open failed");
+      }
+      return file;
+   }
+
+   static void check(int status, const std::string& path) {
+      if(status != MPI_SUCCESS) {
+         std::cerr << "FsGrid I/O on checkpoint file " << path << " failed." << std::endl;
+         throw std::runtime_error("FsGrid checkpoint I/O failed");
+      }
+   }
+
+   /*! Set the file view of a task to its box of the global x-fastest cell array which starts at
+    * byte offset of the file, with cellType (one cell's bytes) as the elementary type.
+    */
+   static void setView(MPI_File file, MPI_Offset offset, MPI_Datatype cellType, const std::array<FsSize_t, 3>& globalSize,
+         const std::array<FsIndex_t, 3>& localStart, const std::array<FsIndex_t, 3>& localSize, const std::string& path) {
+      // Subarrays are given in (z,y,x) order
+      const std::array<int, 3> globalSizes = {(int)globalSize[2], (int)globalSize[1], (int)globalSize[0]};
+      const std::array<int, 3> sizes = {localSize[2], localSize[1], localSize[0]};
+      const std::array<int, 3> starts = {localStart[2], localStart[1], localStart[0]};
+      MPI_Datatype fileType;
+      MPI_Type_create_subarray(3, globalSizes.data(), sizes.data(), starts.data(), MPI_ORDER_C, cellType, &fileType);
+      MPI_Type_commit(&fileType);
+      const int status = MPI_File_set_view(file, offset, cellType, fileType, "native", MPI_INFO_NULL);
+      MPI_Type_free(&fileType);
+      check(status, path);
+   }
+};
+
+/*! Reduction operations of FsGrid::reduce(), and the partial results they combine.
+ * argmin and argmax also find the global coordinates of the extremum; ties go to the cell
+ * that comes first in x-fastest global order.
+ */
+struct FsGridReduction : public FsGridTools {
+   enum Op { sum, min, max, argmin, argmax };
+
+   //! Result of one reduction
+   struct Result {
+      double value;
+      std::array<FsIndex_t, 3> location; //!< Global coordinates of the extremum of argmin and argmax, otherwise {-1,-1,-1}
+   };
+
+   //! Partial result of one reduction over some of the cells
+   struct Partial {
+      double value;
+      int64_t location; //!< Global x-fastest index of the extremum of argmin and argmax, -1 if there is none
+      int32_t op;
+      int32_t padding;
+   };
+
+   //! Partial result over no cells
+   static Partial identity(Op op) {
+      Partial p = {0, -1, op, 0};
+      if(op == min || op == argmin) {
+         p.value = std::numeric_limits<double>::infinity();
+      } else if(op == max || op == argmax) {
+         p.value = -std::numeric_limits<double>::infinity();
+      }
+      return p;
+   }
+
+   //! Add one cell's value to a partial result
+   template<Op op> static inline void accumulate(Partial& p, double value, int64_t location) {
+      if constexpr (op == sum) {
+         p.value += value;
+      } else if constexpr (op == min) {
+         p.value = std::min(p.value, value);
+      } else if constexpr (op == max) {
+         p.value = std::max(p.value, value);
+      } else if constexpr (op == argmin) {
+         if(value < p.value || p.location < 0) {
+            p.value = value;
+            p.location = location;
+         }
+      } else {
+         if(value > p.value || p.location < 0) {
+            p.value = value;
+            p.location = location;
+         }
+      }
+   }
+
+   //! Add one cell's values to the partial results of all ops
+   template<Op... ops, typename V, size_t... I> static inline void accumulate(Partial* partials, const V& values, int64_t location,
+         std::index_sequence<I...>) {
+      (accumulate<ops>(partials[I], values[I], location), ...);
+   }
+
+   //! Combine partial result b into a, as if accumulated over both sets of cells
+   static void combine(Partial& a, const Partial& b) {
+      switch(a.op) {
+         case sum:
+            a.value += b.value;
+            break;
+         case min:
+            a.value = std::min(a.value, b.value);
+            break;
+         case max:
+            a.value = std::max(a.value, b.value);
+            break;
+         default:
+            if(b.location >= 0 && (a.location < 0 || (a.op == argmin ? b.value < a.value : b.value > a.value)
+                     || (b.value == a.value && b.location < a.location))) {
+               a.value = b.value;
+               a.location = b.location;
+            }
+      }
+   }
+
+   //! MPI user operation combining arrays of Partials
+   static void combine(void* in, void* inout, int* len, MPI_Datatype*) {
+      const Partial* b = static_cast<const Partial*>(in);
+      Partial* a = static_cast<Partial*>(inout);
+      for(int i=0; i<*len; i++) {
+         combine(a[i], b[i]);
+      }
+   }
+};
+
+/*! Handle of a non-blocking reduction of N values started with FsGrid::Iallreduce(), holding
+ * its buffers. The result can be collected with wait(), or polled for with test(), while the
+ * caller does other work. Destroying a handle waits for the reduction to finish.
+ */
+template<typename V, size_t N> class FsGridAllreduceFuture {
+   public:
+      /*! Start the reduction over comm, or, with MPI_COMM_NULL, just return the values.
+       * If broadcastComm is given, wait() then passes the result of its rank 0, which has to
+       * be in comm, on to all its tasks.
+       */
+      FsGridAllreduceFuture(const std::array<V, N>& values, MPI_Op op, MPI_Comm comm, MPI_Comm broadcastComm = MPI_COMM_NULL)
+            : buffers(new Buffers), broadcastComm(broadcastComm) {
+         buffers->send = values;
+         if(comm == MPI_COMM_NULL) {
+            buffers->result = values;
+         } else {
+            MPI_Iallreduce(buffers->send.data(), buffers->result.data(), N, FsGridTools::mpiDatatype<V>(), op, comm, &request);
+         }
+      }
+
+      FsGridAllreduceFuture(FsGridAllreduceFuture&& other) noexcept
+            : buffers(std::move(other.buffers)), request(other.request), broadcastComm(other.broadcastComm) {
+         other.request = MPI_REQUEST_NULL;
+         other.broadcastComm = MPI_COMM_NULL;
+      }
+
+      FsGridAllreduceFuture& operator=(FsGridAllreduceFuture&& other) noexcept {
+         if(this != &other) {
+            finish();
+            buffers = std::move(other.buffers);
+            request = other.request;
+            broadcastComm = other.broadcastComm;
+            other.request = MPI_REQUEST_NULL;
+            other.broadcastComm = MPI_COMM_NULL;
+         }
+         return *this;
+      }
+
+      FsGridAllreduceFuture(const FsGridAllreduceFuture&) = delete;
+      FsGridAllreduceFuture& operator=(const FsGridAllreduceFuture&) = delete;
+
+      ~FsGridAllreduceFuture() {
+         finish();
+      }
+
+      //! Whether the reduction (without the broadcast by wait()) has finished, progressing it if not
+      bool test() {
+         int done = 1;
+         if(request != MPI_REQUEST_NULL) {
+            MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+         }
+         return done;
+      }
+
+      /*! Wait for the reduction to finish, and return its result. With a broadcastComm,
+       * the first call is collective over it.
+       */
+      const std::array<V, N>& wait() {
+         finish();
+         if(broadcastComm != MPI_COMM_NULL) {
+            MPI_Bcast(buffers->result.data(), N, FsGridTools::mpiDatatype<V>(), 0, broadcastComm);
+            broadcastComm = MPI_COMM_NULL;
+         }
+         return buffers->result;
+      }
+
+   private:
+      //! Kept on the heap, so that moving the handle doesn't move them under MPI's feet
+      struct Buffers {
+         std::array<V, N> send;
+         std::array<V, N> result;
+      };
+
+      void finish() noexcept {
+         if(request != MPI_REQUEST_NULL) {
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+         }
+      }
+
+      std::unique_ptr<Buffers> buffers;
+      MPI_Request request = MPI_REQUEST_NULL;
+      MPI_Comm broadcastComm = MPI_COMM_NULL; //!< Where wait() still has to pass the result on
+};
+
+/*! Simple cartesian, non-loadbalancing MPI Grid for use with the fieldsolver
+ *
+ * \param T datastructure containing the field in each cell which this grid manages
+ * \param stencil ghost cell width of this grid
+ * \param Layout storage layout of the cells, FsGridLayoutAoS (default), FsGridLayoutSoA or FsGridLayoutAoSoA
+ * \param Allocator allocator of the cell storage
+ */
+template <typename T, int stencil, typename Layout = FsGridLayoutAoS, typename Allocator = FsGridAllocator<T>>
+class FsGrid : public FsGridTools{
+   template<typename, int, typename, typename> friend class FsGrid;
+
+   template<typename ArrayT> void swapArray(std::array<ArrayT, 3>& array) {
+      ArrayT a = array[0];
+      array[0] = array[2];
+      array[2] = a;
+   }
+   public:
+
+      //! What get() returns: a T* if cells are contiguous in storage, a pointer-like proxy otherwise
+      typedef typename std::conditional<Layout::cellsContiguous, T*, FsGridCellPointer<T, Layout>>::type CellPointer;
+
+      /*! Constructor for this grid.
+       * \param globalSize Cell size of the global simulation domain.
+       * \param MPI_Comm The MPI communicator this grid should use.
+       * \param isPeriodic An array specifying, for each dimension, whether it is to be treated as periodic.
+       * \param firstTouch Parallel backend initialising the storage, which places its pages
+       * (see FsGridAllocator); pass the one the grid is later iterated with
+       */
+   template<typename Executor = FsGridOpenMP>
+   FsGrid(std::array<FsSize_t,3> globalSize, MPI_Comm parent_comm, std::array<bool,3> isPeriodic,
+           const std::array<Task_t, 3>& decomposition = {0,0,0}, bool verbose = false, Executor&& firstTouch = Executor())
+            : FsGrid(std::make_shared<FsGridTopology>(globalSize, parent_comm, isPeriodic, stencil, decomposition, verbose),
+                 nullptr, nullptr, 0, firstTouch) {}
+
+      /*! Constructor for a grid whose storage is carved out of an arena.
+       * The arena has to outlive the grid. Other parameters as for the constructor above.
+       */
+   template<typename Executor = FsGridOpenMP>
+   FsGrid(FsGridArena& arena, std::array<FsSize_t,3> globalSize, MPI_Comm parent_comm, std::array<bool,3> isPeriodic,
+           const std::array<Task_t, 3>& decomposition = {0,0,0}, bool verbose = false, Executor&& firstTouch = Executor())
+            : FsGrid(std::make_shared<FsGridTopology>(globalSize, parent_comm, isPeriodic, stencil, decomposition, verbose),
+                 &arena, nullptr, 0, firstTouch) {}
+
+      /*! Constructor for a grid on an existing topology, which may be shared with other grids.
+       * This isn't collective, and doesn't communicate.
+       * \param topology Decomposition and communicators to use, see FsGridTopology
+       * \param arena Arena to take the storage from, or nullptr to allocate it
+       * \param firstTouch Parallel backend initialising the storage, as for the constructor above
+       */
+   template<typename Executor = FsGridOpenMP>
+   FsGrid(std::shared_ptr<FsGridTopology> topology, FsGridArena* arena = nullptr, Executor&& firstTouch = Executor())
+            : FsGrid(std::move(topology), arena, nullptr, 0, firstTouch) {}
+
+      /*! Create a grid which uses the caller's buffer as its storage, without copying.
+       * The grid doesn't take ownership of the buffer, which has to outlive it.
+       * \param buffer Storage for at least getStorageCells() cells of this grid's layout,
+       * e.g. obtained from another grid with the same layout
+       * \param bufferCells Size of buffer, in cells
+       * Other parameters as for the constructor.
+       */
+      static FsGrid wrap(T* buffer, size_t bufferCells, std::array<FsSize_t,3> globalSize, MPI_Comm parent_comm,
+            std::array<bool,3> isPeriodic, const std::array<Task_t, 3>& decomposition = {0,0,0}, bool verbose = false) {
+         return FsGrid(std::make_shared<FsGridTopology>(globalSize, parent_comm, isPeriodic, stencil, decomposition, verbose),
+               nullptr, buffer, bufferCells, FsGridSerial());
+      }
+
+      //! Version of wrap() for an existing topology
+      static FsGrid wrap(T* buffer, size_t bufferCells, std::shared_ptr<FsGridTopology> topology) {
+         return FsGrid(std::move(topology), nullptr, buffer, bufferCells, FsGridSerial());
+      }
+
+      /*! Create a sibling of an existing grid: a grid on the same topology (see FsGridTopology),
+       * with its own cell type, stencil, layout and storage. Like all construction on an
+       * existing topology, this isn't collective.
+       * \param parent Grid to share the topology with
+       * \param arena Arena to take the storage from, or nullptr to allocate it
+       * \param firstTouch Parallel backend initialising the storage, as for the constructor
+       */
+      template<typename ParentT, int parentStencil, typename ParentLayout, typename ParentAllocator, typename Executor = FsGridOpenMP>
+      static FsGrid siblingOf(const FsGrid<ParentT, parentStencil, ParentLayout, ParentAllocator>& parent, FsGridArena* arena = nullptr,
+            Executor&& firstTouch = Executor()) {
+         FsGrid sibling(parent.topology, arena, nullptr, 0, firstTouch);
+         sibling.DX = parent.DX;
+         sibling.DY = parent.DY;
+         sibling.DZ = parent.DZ;
+         sibling.physicalGlobalStart = parent.physicalGlobalStart;
+         sibling.tileSize = parent.tileSize;
+         return sibling;
+      }
+
+   private:
+   template<typename Executor>
+   FsGrid(std::shared_ptr<FsGridTopology> topology, FsGridArena* arena, T* externalStorage, size_t externalCells, Executor&& firstTouch) :
+         topology {std::move(topology)},
+         rank {this->topology->getRank()},
+         neighbour {this->topology->getNeighbours()},
+         ntasksPerDim {this->topology->getDecomposition()},
+         taskPosition {this->topology->getTaskPosition()},
+         periodic {this->topology->getPeriodic()},
+         globalSize {this->topology->getGlobalSize()},
+         localSize {this->topology->getLocalSize()},
+         localStart {this->topology->getLocalStart()}
+      {
+         neighbourSendType.fill(MPI_DATATYPE_NULL);
+         neighbourReceiveType.fill(MPI_DATATYPE_NULL);
+         taskLookup = FsGridTaskLookup(globalSize, ntasksPerDim, stencil, Layout::rowAlignment, Layout::conflictStride, sizeof(T));
+         if constexpr (Layout::fixedDimensions) {
+            for(int i=0; i<3; i++) {
+               if(Layout::extends[i] != (globalSize[i] > 1)) {
+                  std::cerr << "FsGrid layout dimensionality doesn't match global size (" << globalSize[0] << " "
+                     << globalSize[1] << " " << globalSize[2] << ")" << std::endl;
+                  throw std::runtime_error("FsGrid dimensionality mismatch");
+               }
+            }
+         }
+         if(rank == -1) {
+            return;
+         }
+         if(  (globalSize[0] > stencil && localSize[0] < stencil)
+           || (globalSize[1] > stencil && localSize[1] < stencil)
+           || (globalSize[2] > stencil && localSize[2] < stencil)) {
+            std::cerr << "FSGrid topology with local size (" << localSize[0] << " " << localSize[1] << " " << localSize[2]
+               << ") on Rank " << rank << " is too small for stencil " << stencil << "." << std::endl;
+            throw std::runtime_error("FSGrid too small domains");
+         }
+         setupStorage(arena, externalStorage, externalCells, firstTouch);
+      }
+
+   public:
+
+      /*! Get the owned storage vector. This is empty for grids using external storage,
+       * see getStorage() for access that works in both cases.
+       * Note that with the default allocator this is a std::vector<T, FsGridAllocator<T>>, not
+       * a std::vector<T>: code binding the result to std::vector<T>& has to use auto& (or
+       * getStorage()) instead, or instantiate the grid with std::allocator<T>.
+       */
+      std::vector<T, Allocator>& getData(){
+         return this->data;
+      }
+
+      void copyData(FsGrid &other){
+         if(storageCells != other.storageCells) {
+            std::cerr << "FsGrid::copyData: grids have different storage sizes" << std::endl;
+            throw std::runtime_error("FsGrid::copyData storage size mismatch");
+         }
+         std::copy(other.storage, other.storage + other.storageCells, storage);
+      }
+
+      //! Pointer to the cell storage, whether owned or external
+      T* getStorage() {
+         return storage;
+      }
+
+      //! Number of cells (including ghosts and padding) in storage
+      size_t getStorageCells() {
+         return storageCells;
+      }
+
+      //! Whether this grid owns its storage, or uses an arena or a buffer adopted with wrap() or adoptStorage()
+      bool ownsStorage() {
+         return storageCells == 0 || storage == data.data();
+      }
+
+      /*! Switch to using the caller's buffer as storage, without copying. Owned storage is freed.
+       * The grid doesn't take ownership of the buffer, which has to outlive its use here.
+       * \param buffer Storage for at least getStorageCells() cells of this grid's layout
+       * \param bufferCells Size of buffer, in cells
+       */
+      void adoptStorage(T* buffer, size_t bufferCells) {
+         if(rank == -1) return;
+         setExternalStorage(buffer, bufferCells, storageCells);
+         std::vector<T, Allocator>().swap(data);
+      }
+
+      /*! Exchange the storage of two grids of identical layout, without copying. */
+      void swapStorage(FsGrid& other) {
+         if(storageCells != other.storageCells) {
+            std::cerr << "FsGrid::swapStorage: grids have different storage sizes" << std::endl;
+            throw std::runtime_error("FsGrid::swapStorage storage size mismatch");
+         }
+         using std::swap;
+         swap(data, other.data);
+         swap(storage, other.storage);
+      }
+
+      /*! Copy the local (non-ghost) cells of another grid of identical decomposition into this one.
+       * Unlike copyData(), ghost cells and padding are skipped, and rows are copied in parallel.
+       * \param other Grid to copy from
+       * \param executor Parallel backend: FsGridOpenMP (default), FsGridSerial or an FsGridThreadPool
+       */
+      template<typename Executor = FsGridOpenMP>
+      void copyInterior(FsGrid& other, Executor&& executor = Executor()) {
+         if(rank == -1) return;
+         if(localSize != other.localSize || storageCells != other.storageCells) {
+            std::cerr << "FsGrid::copyInterior: grids have different decompositions" << std::endl;
+            throw std::runtime_error("FsGrid::copyInterior decomposition mismatch");
+         }
+         const FsIndex_t rowCells = localSize[0];
+         executor.parallelFor((size_t)localSize[1] * localSize[2], [&](size_t r) {
+            const LocalID row = LocalIDForCoords(0, r % localSize[1], r / localSize[1]);
+            if constexpr(Layout::cellsContiguous) {
+               std::copy(other.storage + row, other.storage + row + rowCells, storage + row);
+            } else {
+               typedef typename FsGridCellTraits<T>::value_type Real;
+               constexpr int components = FsGridCellTraits<T>::components;
+               const Real* src = reinterpret_cast<const Real*>(other.storage);
+               Real* dst = reinterpret_cast<Real*>(storage);
+               for(int c=0; c<components; c++) {
+                  if constexpr(Layout::tiled) {
+                     for(FsIndex_t x=0; x<rowCells; x++) {
+                        const size_t i = Layout::offset(row + x, c, components, storageCells);
+                        dst[i] = src[i];
+                     }
+                  } else {
+                     const size_t i = Layout::offset(row, c, components, storageCells);
+                     std::copy(src + i, src + i + rowCells, dst + i);
+                  }
+               }
+            }
+         });
+      }
+
+      /*! 
+       *  MPI calls fail after the main program called MPI_Finalize(),
+       *  so this can be used instead of the destructor
+       *  Releases the topology, which frees the cartesian communicator and datatypes
+       *  once no grid uses them any more
+       */
+      void finalize() noexcept {
+         topology.reset();
+         neighbourSendType.fill(MPI_DATATYPE_NULL);
+         neighbourReceiveType.fill(MPI_DATATYPE_NULL);
+      }
+
+      /*!
+       *  If finalize() isn't called manually, object should be destroyed before MPI finalization
+       */
+      ~FsGrid() {
+         finalize();
+      }
+
+      friend void swap (FsGrid& first, FsGrid& second) noexcept {
+         using std::swap;
+         swap(first.DX, second.DX);
+         swap(first.DY, second.DY);
+         swap(first.DZ, second.DZ);
+         swap(first.physicalGlobalStart, second.physicalGlobalStart);
+         swap(first.topology, second.topology);
+         swap(first.rank, second.rank);
+         swap(first.requests, second.requests);
+         swap(first.numRequests, second.numRequests);
+         swap(first.neighbour, second.neighbour);
+         swap(first.taskLookup, second.taskLookup);
+         swap(first.ntasksPerDim, second.ntasksPerDim);
+         swap(first.taskPosition, second.taskPosition);
+         swap(first.periodic, second.periodic);
+         swap(first.globalSize, second.globalSize);
+         swap(first.localSize, second.localSize);
+         swap(first.storageSize, second.storageSize);
+         swap(first.storageStride, second.storageStride);
+         swap(first.tileSize, second.tileSize);
+         swap(first.localStart, second.localStart);
+         swap(first.neighbourSendType, second.neighbourSendType);
+         swap(first.neighbourReceiveType, second.neighbourReceiveType);
+         swap(first.data, second.data);
+         swap(first.storage, second.storage);
+         swap(first.storageCells, second.storageCells);
+      }
+
+      // Copy constructor
+      FsGrid(const FsGrid& other) : 
+         DX {other.DX},
+         DY {other.DY},
+         DZ {other.DZ},
+         physicalGlobalStart {other.physicalGlobalStart},
+         topology {other.topology},
+         rank {other.rank}, 
+         requests {}, 
+         numRequests {0}, 
+         neighbour {other.neighbour},
+         taskLookup {other.taskLookup},
+         ntasksPerDim {other.ntasksPerDim},
+         taskPosition {other.taskPosition},
+         periodic {other.periodic},
+         globalSize {other.globalSize},
+         localSize {other.localSize},
+         storageSize {other.storageSize},
+         storageStride {other.storageStride},
+         localStart {other.localStart},
+         neighbourSendType {other.neighbourSendType},
+         neighbourReceiveType {other.neighbourReceiveType},
+         tileSize {other.tileSize},
+         data (other.storage, other.storage + other.storageCells),
+         storage {data.data()},
+         storageCells {data.size()}
+      {
+      }
+
+      // Move constructor
+      // We don't have a default constructor, so just set the MPI stuff NULL
+      FsGrid(FsGrid&& other) noexcept : 
+         neighbourSendType {},
+         neighbourReceiveType {}
+      {
+         // NULL all the MPI stuff so the moved-from grid is left empty
+         neighbourSendType.fill(MPI_DATATYPE_NULL);
+         neighbourReceiveType.fill(MPI_DATATYPE_NULL);
+
+         using std::swap;
+         swap(*this, other);
+      }
+
+      // Copy assignment
+      // Canonical copy assign is construct to temp and swap, but this would result in an extra allocation of the entire grid
+      // Copy assignment is currently not used in Vlasiator, so the operator is deleted as any use is likely either erroneous or just a bad idea
+      FsGrid& operator=(FsGrid other) = delete;
+
+      // Move assignment
+      FsGrid& operator=(FsGrid&& other) noexcept {
+         using std::swap;
+         swap(*this, other);
+         return *this;
+      }
+
+      /*! Returns the task responsible, and its localID for handling the cell with the given GlobalID
+       * \param id GlobalID of the cell for which task is to be determined
+       * \return a task for the grid's cartesian communicator
+       */
+      std::pair<int,LocalID> getTaskForGlobalID(GlobalID id) {
+         if(id < 0 || id >= (GlobalID)globalSize[0] * globalSize[1] * globalSize[2]) {
+            std::cerr << "Unable to find FsGrid rank for global ID " << id << " (outside of the "
+               << globalSize[0] << " x " << globalSize[1] << " x " << globalSize[2] << " grid)" << std::endl;
+            return std::pair<int,LocalID>(MPI_PROC_NULL,0);
+         }
+         std::pair<int,LocalID> retVal;
+         taskLookup.lookupGlobalIDs(1, &id, &retVal.first, &retVal.second);
+         return retVal;
+      }
+
+      /*! Batch version of getTaskForGlobalID(), for many cells at once
+       * \param n Number of cells
+       * \param ids GlobalIDs of the cells
+       * \param tasks Output: task for the grid's cartesian communicator, for each cell
+       * \param localIDs Output: LocalID of each cell within its task
+       */
+      void getTasksForGlobalIDs(size_t n, const GlobalID* ids, Task_t* tasks, LocalID* localIDs) {
+         taskLookup.lookupGlobalIDs(n, ids, tasks, localIDs);
+      }
+
+      /*! Like getTasksForGlobalIDs(), but for cells given by global cell coordinates
+       * \param n Number of cells
+       * \param x,y,z Global cell coordinates of the cells
+       * \param tasks Output: task for the grid's cartesian communicator, for each cell
+       * \param localIDs Output: LocalID of each cell within its task
+       */
+      void getTasksForGlobalCoords(size_t n, const FsIndex_t* x, const FsIndex_t* y, const FsIndex_t* z, Task_t* tasks, LocalID* localIDs) {
+         taskLookup.lookupCoords(n, x, y, z, tasks, localIDs);
+      }
+
+      /*! Transform global cell coordinates into the local domain.
+       * If the coordinates are out of bounds, (-1,-1,-1) is returned.
+       * \param x The cell's global x coordinate
+       * \param y The cell's global y coordinate
+       * \param z The cell's global z coordinate
+       */
+      std::array<FsIndex_t, 3> globalToLocal(FsSize_t x, FsSize_t y, FsSize_t z) {
+         std::array<FsIndex_t, 3> retval;
+         retval[0] = (FsIndex_t)x - localStart[0];
+         retval[1] = (FsIndex_t)y - localStart[1];
+         retval[2] = (FsIndex_t)z - localStart[2];
+
+         if(retval[0] >= localSize[0] || retval[1] >= localSize[1] || retval[2] >= localSize[2]
+               || retval[0] < 0 || retval[1] < 0 || retval[2] < 0) {
+            return {-1,-1,-1};
+         }
+
+         return retval;
+      }
+
+      /*! Determine the cell's GlobalID from its local x,y,z coordinates
+       * \param x The cell's task-local x coordinate
+       * \param y The cell's task-local y coordinate
+       * \param z The cell's task-local z coordinate
+       */
+      GlobalID GlobalIDForCoords(int x, int y, int z) {
+         return x + localStart[0] + globalSize[0] * (y + localStart[1]) + globalSize[0] * globalSize[1] * (z + localStart[2]);
+      }
+      /*! Determine the cell's LocalID from its local x,y,z coordinates
+       * \param x The cell's task-local x coordinate
+       * \param y The cell's task-local y coordinate
+       * \param z The cell's task-local z coordinate
+       */
+      LocalID LocalIDForCoords(int x, int y, int z) {
+         if constexpr (Layout::fixedDimensions) {
+            // Collapsed dimensions are left out at compile time, and rows are contiguous
+            LocalID id = 0;
+            if constexpr (Layout::extends[0]) id += stencil+x;
+            if constexpr (Layout::extends[1]) id += storageStride[1]*(stencil+y);
+            if constexpr (Layout::extends[2]) id += storageStride[2]*(stencil+z);
+            return id;
+         } else {
+            // Collapsed dimensions have zero stride, and thus don't contribute
+            return storageStride[0]*(stencil+x) + storageStride[1]*(stencil+y) + storageStride[2]*(stencil+z);
+         }
+      }
+
+      /*! Get an unchecked view of the local storage, for use in solver kernels.
+       * See FsGridView for details.
+       */
+      FsGridView<T> getView() {
+         static_assert(Layout::cellsContiguous, "FsGrid::getView() needs a layout with contiguous cells, use getComponentView()");
+         if(rank == -1) {
+            return FsGridView<T>();
+         }
+         return FsGridView<T>(storage + LocalIDForCoords(0,0,0), storageStride, localSize, stencil);
+      }
+
+      /*! Get an unchecked view of a single component of all cells. With FsGridLayoutSoA,
+       * this is a unit-stride view of the component's array. See FsGridView for details.
+       * With FsGridLayoutAoSoA, an FsGridTiledView is returned instead.
+       * \param component Index of the component in the cell's std::array
+       */
+      template<typename Cell = T>
+      auto getComponentView(int component) {
+         typedef typename FsGridCellTraits<Cell>::value_type Real;
+         const int components = FsGridCellTraits<Cell>::components;
+         Real* base = reinterpret_cast<Real*>(storage);
+         if constexpr (Layout::tiled) {
+            if(rank == -1) {
+               return FsGridTiledView<Real, Layout::tileWidth>();
+            }
+            return FsGridTiledView<Real, Layout::tileWidth>(base + Layout::offset(0, component, components, storageCells),
+                  LocalIDForCoords(0,0,0), storageStride, components, localSize, stencil);
+         } else {
+            if(rank == -1) {
+               return FsGridView<Real>();
+            }
+            // Without tiling, neighbouring cells' components are a fixed distance apart
+            std::array<LocalID, 3> componentStride;
+            for(int i=0; i<3; i++) {
+               componentStride[i] = Layout::offset(storageStride[i], 0, components, storageCells) - Layout::offset(0, 0, components, storageCells);
+            }
+            return FsGridView<Real>(base + Layout::offset(LocalIDForCoords(0,0,0), component, components, storageCells),
+                  componentStride, localSize, stencil);
+         }
+      }
+
+      /*! Call func for every cell in a box of local cells. The box is split into cache tiles
+       * (see setTileSize()), which are distributed over the threads of the executor.
+       * func is called as func(x, y, z, cell) with task-local coordinates, where cell is either
+       * a CellPointer (as returned by get()) or, with the default layout, an FsGridView<T>::Cell
+       * (for neighbour access), whichever func accepts. func may also take just (x, y, z).
+       * Calls for different cells may happen concurrently.
+       * \param start Task-local coordinates of the first cell of the box
+       * \param size Number of cells in the box, in each dimension
+       * \param func Function to call for each cell
+       * \param executor Parallel backend: FsGridOpenMP (default), FsGridSerial or an FsGridThreadPool
+       */
+      template<typename F, typename Executor = FsGridOpenMP>
+      void forEachInBox(const std::array<FsIndex_t, 3>& start, const std::array<FsIndex_t, 3>& size, F&& func, Executor&& executor = Executor()) {
+         if(rank == -1 || size[0] <= 0 || size[1] <= 0 || size[2] <= 0) {
+            return;
+         }
+         forEachTile(start, size, [&](size_t, const std::array<FsIndex_t, 3>& low, const std::array<FsIndex_t, 3>& high) {
+            for(int z=low[2]; z<high[2]; z++) {
+               for(int y=low[1]; y<high[1]; y++) {
+                  const LocalID row = LocalIDForCoords(0, y, z);
+                  for(int x=low[0]; x<high[0]; x++) {
+                     callCellFunction(func, x, y, z, row + x * storageStride[0]);
+                  }
+               }
+            }
+         }, executor);
+      }
+
+      /*! Call func for every local (non-ghost) cell. See forEachInBox() for details. */
+      template<typename F, typename Executor = FsGridOpenMP>
+      void forEachCell(F&& func, Executor&& executor = Executor()) {
+         forEachInBox({0, 0, 0}, localSize, std::forward<F>(func), std::forward<Executor>(executor));
+      }
+
+      /*! Call func for every local cell whose stencil neighbourhood lies completely within
+       * the local domain, i.e. which doesn't need ghost cells. Together with forEachBoundary()
+       * this allows computing while ghost cells are being exchanged.
+       * See forEachInBox() for details.
+       */
+      template<typename F, typename Executor = FsGridOpenMP>
+      void forEachInterior(F&& func, Executor&& executor = Executor()) {
+         std::array<FsIndex_t, 3> start, size;
+         for(int i=0; i<3; i++) {
+            start[i] = globalSize[i] > 1 ? stencil : 0;
+            size[i] = localSize[i] - 2 * start[i];
+         }
+         forEachInBox(start, size, std::forward<F>(func), std::forward<Executor>(executor));
+      }
+
+      /*! Call func for every local cell within a stencil width of the local domain's boundary,
+       * i.e. all the cells forEachInterior() skips. See forEachInBox() for details.
+       */
+      template<typename F, typename Executor = FsGridOpenMP>
+      void forEachBoundary(F&& func, Executor&& executor = Executor()) {
+         // Boundary shell is split into slabs: full xy-planes at low and high z, then
+         // full x-rows at low and high y, and finally the remaining cells at low and high x.
+         std::array<FsIndex_t, 3> low, high;
+         for(int i=0; i<3; i++) {
+            const FsIndex_t width = globalSize[i] > 1 ? stencil : 0;
+            low[i] = std::min(width, localSize[i]);
+            high[i] = std::max(localSize[i] - width, low[i]);
+         }
+         const std::array<FsIndex_t, 3>& L = localSize;
+         forEachInBox({0, 0, 0}, {L[0], L[1], low[2]}, func, executor);
+         forEachInBox({0, 0, high[2]}, {L[0], L[1], L[2] - high[2]}, func, executor);
+         forEachInBox({0, 0, low[2]}, {L[0], low[1], high[2] - low[2]}, func, executor);
+         forEachInBox({0, high[1], low[2]}, {L[0], L[1] - high[1], high[2] - low[2]}, func, executor);
+         forEachInBox({0, low[1], low[2]}, {low[0], high[1] - low[1], high[2] - low[2]}, func, executor);
+         forEachInBox({high[0], low[1], low[2]}, {L[0] - high[0], high[1] - low[1], high[2] - low[2]}, func, executor);
+      }
+
+      /*! Compute several global reductions of per-cell quantities in a single pass over the local
+       * (non-ghost) cells and a single collective, e.g. max |B|, total energy and the location of
+       * the minimum density at once:
+       *
+       * auto r = grid.reduce<FsGridReduction::max, FsGridReduction::sum, FsGridReduction::argmin>(
+       *    [](int x, int y, int z, auto cell) { return std::array<double, 3>{bAbs(cell), energy(cell), rho(cell)}; });
+       *
+       * func is called like the function of forEachCell(), and returns one value per op, indexable
+       * with []. Cells are visited in cache tiles over the threads of the executor; the partial
+       * results of the tiles are combined in a fixed order, and those of the tasks with a
+       * non-commutative MPI operation, which MPI applies in rank order. Sums are thereby
+       * reproducible from run to run for a given decomposition and tile size, independent of the
+       * number of threads. Collective over all tasks of the communicator the grid was
+       * built from: non-FS tasks contribute no cells, and get the same result as everyone else.
+       * \param func Function returning the values of a cell
+       * \param executor Parallel backend: FsGridOpenMP (default), FsGridSerial or an FsGridThreadPool
+       * \return One result per op, in order
+       */
+      template<FsGridReduction::Op... ops, typename F, typename Executor = FsGridOpenMP>
+      std::array<FsGridReduction::Result, sizeof...(ops)> reduce(F&& func, Executor&& executor = Executor()) {
+         typedef FsGridReduction::Partial Partial;
+         constexpr size_t N = sizeof...(ops);
+         static_assert(N > 0, "FsGrid::reduce() needs at least one op");
+         constexpr bool located = ((ops == FsGridReduction::argmin || ops == FsGridReduction::argmax) || ...);
+         const std::array<Partial, N> identity = {FsGridReduction::identity(ops)...};
+
+         std::array<Partial, N> partials = identity;
+         if(rank != -1) {
+            const std::array<FsIndex_t, 3> ntiles = tileCounts(localSize);
+            std::vector<std::array<Partial, N>> tilePartials((size_t)ntiles[0] * ntiles[1] * ntiles[2], identity);
+            forEachTile({0, 0, 0}, localSize, [&](size_t tile, const std::array<FsIndex_t, 3>& low, const std::array<FsIndex_t, 3>& high) {
+               std::array<Partial, N> p = identity;
+               for(int z=low[2]; z<high[2]; z++) {
+                  for(int y=low[1]; y<high[1]; y++) {
+                     const LocalID row = LocalIDForCoords(0, y, z);
+                     const int64_t rowLocation = located ? localStart[0] + (int64_t)globalSize[0]
+                        * (localStart[1] + y + (int64_t)globalSize[1] * (localStart[2] + z)) : 0;
+                     for(int x=low[0]; x<high[0]; x++) {
+                        const auto values = callCellFunction(func, x, y, z, row + x * storageStride[0]);
+                        FsGridReduction::accumulate<ops...>(p.data(), values, rowLocation + x, std::make_index_sequence<N>());
+                     }
+                  }
+               }
+               tilePartials[tile] = p;
+            }, executor);
+            for(const std::array<Partial, N>& p : tilePartials) {
+               for(size_t i=0; i<N; i++) {
+                  FsGridReduction::combine(partials[i], p[i]);
+               }
+            }
+         }
+
+         const std::pair<MPI_Datatype, MPI_Op> op = topology->getReductionOp(sizeof(Partial), &FsGridReduction::combine);
+         std::array<Partial, N> totals;
+         MPI_Allreduce(partials.data(), totals.data(), N, op.first, op.second, topology->getParentComm());
+
+         std::array<FsGridReduction::Result, N> results;
+         for(size_t i=0; i<N; i++) {
+            results[i].value = totals[i].value;
+            results[i].location = {-1, -1, -1};
+            if(totals[i].location >= 0) {
+               results[i].location[0] = totals[i].location % globalSize[0];
+               results[i].location[1] = totals[i].location / globalSize[0] % globalSize[1];
+               results[i].location[2] = totals[i].location / globalSize[0] / globalSize[1];
+            }
+         }
+         return results;
+      }
+
+      /*! Set the cache tile shape used by the cell iteration functions, in cells.
+       * The default is FsGridTools::defaultTileSize.
+       */
+      void setTileSize(const std::array<FsIndex_t, 3>& size) {
+         tileSize = size;
+      }
+
+      const std::array<FsIndex_t, 3>& getTileSize() const {
+         return tileSize;
+      }
+
+      /*! Perform ghost cell communication.
+       */
+      void updateGhostCells() {
+         updateGhostCells(0, componentsPerElement());
+      }
+
+      /*! Perform ghost cell communication for a range of cell components only.
+       * With layouts keeping cells contiguous, whole cells are always exchanged.
+       * \param firstComponent Index of the first component to exchange
+       * \param numComponents Number of consecutive components to exchange
+       */
+      void updateGhostCells(int firstComponent, int numComponents) {
+
+         if(rank == -1) return;
+
+         if constexpr (Layout::cellsContiguous) {
+            firstComponent = 0;
+            numComponents = 1;
+         }
+         // Ghost datatypes span the whole storage of one component, so consecutive
+         // components are consecutive elements.
+         char* base = reinterpret_cast<char*>(storage)
+            + Layout::offset(0, firstComponent, componentsPerElement(), storageCells) * (sizeof(T) / componentsPerElement());
+
+         //TODO, faster with simultaneous isends& ireceives?
+         std::array<MPI_Request, 27> receiveRequests;
+         std::array<MPI_Request, 27> sendRequests;
+         
+         for(int i = 0; i < 27; i++){
+            receiveRequests[i] = MPI_REQUEST_NULL;
+            sendRequests[i] = MPI_REQUEST_NULL;
+         }
+         
+         // Only shift along dimensions which aren't known to be collapsed
+         constexpr int rx = collapsedAtCompileTime(0) ? 0 : 1;
+         constexpr int ry = collapsedAtCompileTime(1) ? 0 : 1;
+         constexpr int rz = collapsedAtCompileTime(2) ? 0 : 1;
+         
+         for(int x=-rx; x<=rx;x++) {
+            for(int y=-ry; y<=ry;y++) {
+               for(int z=-rz; z<=rz; z++) {
+                  int shiftId = (x+1) * 9 + (y + 1) * 3 + (z + 1);
+                  int receiveId = (1 - x) * 9 + ( 1 - y) * 3 + ( 1 - z);
+                  if(neighbour[receiveId] != MPI_PROC_NULL &&
+                     neighbourSendType[shiftId] != MPI_DATATYPE_NULL) {
+                     MPI_Irecv(base, numComponents, neighbourReceiveType[shiftId], neighbour[receiveId], shiftId, topology->getComm(), &(receiveRequests[shiftId]));
+                  }
+               }
+            }
+         }
+         
+         for(int x=-rx; x<=rx;x++) {
+            for(int y=-ry; y<=ry;y++) {
+               for(int z=-rz; z<=rz; z++) {
+                  int shiftId = (x+1) * 9 + (y + 1) * 3 + (z + 1);
+                  int sendId = shiftId;
+                  if(neighbour[sendId] != MPI_PROC_NULL &&
+                     neighbourSendType[shiftId] != MPI_DATATYPE_NULL) {
+                     MPI_Isend(base, numComponents, neighbourSendType[shiftId], neighbour[sendId], shiftId, topology->getComm(), &(sendRequests[shiftId]));
+                  }
+               }
+            }
+         }
+         MPI_Waitall(27, receiveRequests.data(), MPI_STATUSES_IGNORE);         
+         MPI_Waitall(27, sendRequests.data(), MPI_STATUSES_IGNORE);
+      }
+   
+      /*! Get the size of the local domain handled by this grid.
+       */
+      std::array<FsIndex_t, 3>& getLocalSize() {
+         return localSize;
+      }
+
+      /*! Get the start coordinates of the local domain handled by this grid.
+       */
+      std::array<FsIndex_t, 3>& getLocalStart() {
+         return localStart;
+      }
+
+      /*! Get global size of the fsgrid domain
+       */
+      std::array<FsSize_t, 3>& getGlobalSize() {
+         return globalSize;
+      }
+
+      /*! Calculate global cell position (XYZ in global cell space) from local cell coordinates.
+       *
+       * \param x x-Coordinate, in cells
+       * \param y y-Coordinate, in cells
+       * \param z z-Coordinate, in cells
+       *
+       * \return Global cell coordinates
+       */
+      std::array<FsIndex_t, 3> getGlobalIndices(int64_t x, int64_t y, int64_t z) {
+         std::array<FsIndex_t, 3> retval;
+         retval[0] = localStart[0] + x;
+         retval[1] = localStart[1] + y;
+         retval[2] = localStart[2] + z;
+
+         return retval;
+      }
+
+      /*! Get a reference to the field data in a cell
+       * \param x x-Coordinate, in cells
+       * \param y y-Coordinate, in cells
+       * \param z z-Coordinate, in cells
+       * \return A reference to cell data in the given cell
+       */
+      CellPointer get(int x, int y, int z) {
+
+         // Keep track which neighbour this cell actually belongs to (13 = ourself)
+         // (dimensions known to be collapsed are skipped at compile time)
+         constexpr bool checkX = !collapsedAtCompileTime(0);
+         constexpr bool checkY = !collapsedAtCompileTime(1);
+         constexpr bool checkZ = !collapsedAtCompileTime(2);
+         int isInNeighbourDomain=13;
+         int coord_shift[3] = {0,0,0};
+         if(checkX && x < 0) {
+            isInNeighbourDomain -= 9;
+            coord_shift[0] = 1;
+         }
+         if(checkX && x >= localSize[0]) {
+            isInNeighbourDomain += 9;
+            coord_shift[0] = -1;
+         }
+         if(checkY && y < 0) {
+            isInNeighbourDomain -= 3;
+            coord_shift[1] = 1;
+         }
+         if(checkY && y >= localSize[1]) {
+            isInNeighbourDomain += 3;
+            coord_shift[1] = -1;
+         }
+         if(checkZ && z < 0) {
+            isInNeighbourDomain -= 1;
+            coord_shift[2] = 1;
+         }
+         if(checkZ && z >= localSize[2]) {
+            isInNeighbourDomain += 1;
+            coord_shift[2] = -1;
+         }
+
+         // Santiy-Check that the requested cell is actually inside our domain
+         // TODO: ugh, this is ugly.
+#ifdef FSGRID_DEBUG
+         bool inside=true;
+         if(localSize[0] <= 1 && !periodic[0]) {
+            if(x != 0) {
+               std::cerr << "x != 0 despite non-periodic x-axis with only one cell." << std::endl;
+               inside = false;
+            }
+         } else {
+            if(x < -stencil || x >= localSize[0] + stencil) {
+               std::cerr << "x = " << x << " is outside of [ " << -stencil << 
+                  ", " << localSize[0] + stencil << "[!" << std::endl;
+               inside = false;
+            }
+         }
+
+         if(localSize[1] <= 1 && !periodic[1]) {
+            if(y != 0) {
+               std::cerr << "y != 0 despite non-periodic y-axis with only one cell." << std::endl;
+               inside = false;
+            }
+         } else {
+            if(y < -stencil || y >= localSize[1] + stencil) {
+               std::cerr << "y = " << y << " is outside of [ " << -stencil <<
+                  ", " << localSize[1] + stencil << "[!" << std::endl;
+               inside = false;
+            }
+         }
+
+         if(localSize[2] <= 1 && !periodic[2]) {
+            if(z != 0) {
+               std::cerr << "z != 0 despite non-periodic z-axis with only one cell." << std::endl;
+               inside = false;
+            }
+         } else {
+            if(z < -stencil || z >= localSize[2] + stencil) {
+               inside = false;
+               std::cerr << "z = " << z << " is outside of [ " << -stencil <<
+                  ", " << localSize[2] + stencil << "[!" << std::endl;
+            }
+         }
+         if(!inside) {
+            std::cerr << "Out-of bounds access in FsGrid::get! Expect weirdness." << std::endl;
+            return NULL;
+         }
+#endif // FSGRID_DEBUG
+
+         if(isInNeighbourDomain != 13) {
+
+            // Check if the corresponding neighbour exists
+            if(neighbour[isInNeighbourDomain]==MPI_PROC_NULL) {
+               // Neighbour doesn't exist, we must be an outer boundary cell
+               // (or something is quite wrong)
+               return NULL;
+
+            } else if(neighbour[isInNeighbourDomain] == rank) {
+               // For periodic boundaries, where the neighbour is actually ourself,
+               // return our own actual cell instead of the ghost
+               x += coord_shift[0] * localSize[0];
+               y += coord_shift[1] * localSize[1];
+               z += coord_shift[2] * localSize[2];
+            }
+            // Otherwise we return the ghost cell
+         }
+         LocalID index = LocalIDForCoords(x,y,z);
+
+         return cellPointer(index);
+      }
+
+      CellPointer get(LocalID id) {
+         if(id < 0 || (unsigned int)id > storageCells) {
+            std::cerr << "Out-of-bounds access in FsGrid::get!" << std::endl
+               << "(LocalID = " << id << ", but storage space is " << storageCells
+               << ". Expect weirdness." << std::endl;
+            return NULL;
+         }
+         return cellPointer(id);
+      }
+
+      /*! Copy a box of local (non-ghost) cells into a contiguous buffer, in x-fastest order.
+       * \param start Task-local coordinates of the first cell of the box
+       * \param size Number of cells in the box, in each dimension
+       * \param buffer Destination, with room for size[0]*size[1]*size[2] cells
+       */
+      void packBox(const std::array<FsIndex_t, 3>& start, const std::array<FsIndex_t, 3>& size, T* buffer) {
+         for(int z=0; z<size[2]; z++) {
+            for(int y=0; y<size[1]; y++) {
+               const LocalID row = LocalIDForCoords(start[0], start[1] + y, start[2] + z);
+               if constexpr (Layout::cellsContiguous) {
+                  buffer = std::copy(&storage[row], &storage[row] + size[0], buffer);
+               } else {
+                  for(int x=0; x<size[0]; x++) {
+                     *buffer++ = *cellPointer(row + x);
+                  }
+               }
+            }
+         }
+      }
+
+      /*! Copy a contiguous buffer of cells, in x-fastest order, into a box of local (non-ghost) cells.
+       * \param start Task-local coordinates of the first cell of the box
+       * \param size Number of cells in the box, in each dimension
+       * \param buffer Source, holding size[0]*size[1]*size[2] cells
+       */
+      void unpackBox(const std::array<FsIndex_t, 3>& start, const std::array<FsIndex_t, 3>& size, const T* buffer) {
+         for(int z=0; z<size[2]; z++) {
+            for(int y=0; y<size[1]; y++) {
+               const LocalID row = LocalIDForCoords(start[0], start[1] + y, start[2] + z);
+               if constexpr (Layout::cellsContiguous) {
+                  std::copy(buffer, buffer + size[0], &storage[row]);
+                  buffer += size[0];
+               } else {
+                  for(int x=0; x<size[0]; x++) {
+                     *cellPointer(row + x) = *buffer++;
+                  }
+               }
+            }
+         }
+      }
+
+      /*! Write the interior cells of the grid into a checkpoint file, together with a header
+       * holding the global size, cell size and physical extent (see FsGridCheckpointHeader).
+       * This is collective over the grid's tasks, which write their boxes with a single
+       * collective MPI-IO call through a global subarray file view; non-FS tasks return at once.
+       * An existing file is overwritten.
+       * \param path Name of the file
+       */
+      void writeCheckpoint(const std::string& path) {
+         if(rank == -1) {
+            return;
+         }
+         MPI_File file = FsGridCheckpointIO::open(path, MPI_MODE_CREATE | MPI_MODE_WRONLY, topology->getComm());
+         MPI_File_set_size(file, 0);
+         if(rank == 0) {
+            const FsGridCheckpointHeader header = FsGridCheckpointIO::makeHeader(sizeof(T), globalSize, {DX, DY, DZ}, physicalGlobalStart);
+            FsGridCheckpointIO::check(MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE), path);
+         }
+         transferCheckpointCells(file, sizeof(FsGridCheckpointHeader), path, true);
+         MPI_File_close(&file);
+      }
+
+      /*! Read the interior cells of the grid from a checkpoint file written by writeCheckpoint(),
+       * and take over DX, DY, DZ and physicalGlobalStart from its header. Ghost cells are not
+       * updated. The file may have been written by a grid of any decomposition, number of tasks
+       * and storage layout; each task reads its own box through its subarray file view.
+       * Collective over the grid's tasks; non-FS tasks only read the header.
+       * Throws if the file's global size or cell size doesn't match this grid's.
+       * \param path Name of the file
+       */
+      void readCheckpoint(const std::string& path) {
+         // Non-FS tasks' auxiliary communicators can overlap FS tasks, so they read the header on their own
+         const FsGridCheckpointHeader header = FsGridCheckpointHeader::read(path, rank == -1 ? MPI_COMM_SELF : topology->getComm());
+         if(header.cellBytes != sizeof(T) || header.globalSize[0] != globalSize[0]
+               || header.globalSize[1] != globalSize[1] || header.globalSize[2] != globalSize[2]) {
+            if(rank == 0) {
+               std::cerr << "FsGrid checkpoint " << path << " doesn't match the grid of size (" << globalSize[0] << " "
+                  << globalSize[1] << " " << globalSize[2] << ") and " << sizeof(T) << " byte cells." << std::endl;
+            }
+            throw std::runtime_error("FsGrid checkpoint mismatch");
+         }
+         DX = header.spacing[0];
+         DY = header.spacing[1];
+         DZ = header.spacing[2];
+         std::copy(header.physicalGlobalStart, header.physicalGlobalStart + 3, physicalGlobalStart.begin());
+         if(rank == -1) {
+            return;
+         }
+         MPI_File file = FsGridCheckpointIO::open(path, MPI_MODE_RDONLY, topology->getComm());
+         transferCheckpointCells(file, header.dataOffset, path, false);
+         MPI_File_close(&file);
+      }
+
+      /*! Write the interior cells of the grid into a chunked output file, which FsGridChunkedReader
+       * can map into memory and read arbitrary boxes and components from (see FsGridChunkedHeader).
+       * Chunks are the tiles of a global chunkSize grid, cut at task boundaries, so every task
+       * writes its own chunks. They are packed and compressed in parallel, and written together with
+       * their index entries by collective MPI-IO calls. Collective over the grid's tasks; non-FS tasks
+       * return at once. Requires std::array cells. An existing file is overwritten.
+       * \param path Name of the file
+       * \param chunkSize Largest size of a chunk, in cells
+       * \param compression Compression of the chunks, none by default
+       * \param executor Parallel backend of the chunk packing and compression
+       */
+      template<typename Executor = FsGridOpenMP>
+      void writeChunked(const std::string& path, const std::array<FsIndex_t, 3>& chunkSize = {64, 64, 64},
+            const FsGridCompression& compression = FsGridCompression(), Executor&& executor = Executor()) {
+         if(rank == -1) {
+            return;
+         }
+         typedef typename FsGridCellTraits<T>::value_type value_type;
+         const int components = FsGridCellTraits<T>::components;
+         const uint64_t alignment = 4096;
+
+         // Our chunks, with payload offsets relative to our first one
+         std::vector<FsGridChunkEntry> chunks;
+         uint64_t bytes = 0;
+         std::array<FsIndex_t, 3> first, last;
+         for(int i=0; i<3; i++) {
+            first[i] = localStart[i] / chunkSize[i];
+            last[i] = (localStart[i] + localSize[i] - 1) / chunkSize[i];
+         }
+         for(FsIndex_t cz = first[2]; cz <= last[2]; cz++) {
+            for(FsIndex_t cy = first[1]; cy <= last[1]; cy++) {
+               for(FsIndex_t cx = first[0]; cx <= last[0]; cx++) {
+                  const std::array<FsIndex_t, 3> c = {cx, cy, cz};
+                  FsGridChunkEntry chunk = {};
+                  for(int i=0; i<3; i++) {
+                     const FsIndex_t start = std::max(c[i] * chunkSize[i], localStart[i]);
+                     const FsIndex_t end = std::min((c[i] + 1) * chunkSize[i], localStart[i] + localSize[i]);
+                     chunk.start[i] = start;
+                     chunk.size[i] = end - start;
+                  }
+                  chunk.offset = bytes;
+                  chunk.bytes = chunk.cells() * sizeof(T);
+                  bytes += (chunk.bytes + alignment - 1) / alignment * alignment;
+                  chunks.push_back(chunk);
+               }
+            }
+         }
+         std::vector<char> payload(bytes);
+         executor.parallelFor(chunks.size(), [&](size_t i) {
+            const FsGridChunkEntry& chunk = chunks[i];
+            value_type* values = reinterpret_cast<value_type*>(payload.data() + chunk.offset);
+            const size_t cells = chunk.cells();
+            size_t cell = 0;
+            for(uint32_t z=0; z<chunk.size[2]; z++) {
+               for(uint32_t y=0; y<chunk.size[1]; y++) {
+                  const LocalID row = LocalIDForCoords(chunk.start[0] - localStart[0], chunk.start[1] - localStart[1] + y,
+                        chunk.start[2] - localStart[2] + z);
+                  for(uint32_t x=0; x<chunk.size[0]; x++, cell++) {
+                     const CellPointer p = cellPointer(row + x);
+                     for(int c=0; c<components; c++) {
+                        values[c * cells + cell] = (*p)[c];
+                     }
+                  }
+               }
+            }
+         });
+
+         if(compression.codec != FsGridCompression::none) {
+            std::vector<std::vector<char>> encoded(chunks.size());
+            executor.parallelFor(chunks.size(), [&](size_t i) {
+               FsGridChunkEntry& chunk = chunks[i];
+               const value_type* values = reinterpret_cast<const value_type*>(payload.data() + chunk.offset);
+               chunk.codec = FsGridCodec::encode(values, chunk.cells(), components, compression, encoded[i]);
+            });
+            // Pack the encoded chunks, at their own aligned offsets
+            std::vector<char> compressed;
+            bytes = 0;
+            for(size_t i=0; i<chunks.size(); i++) {
+               FsGridChunkEntry& chunk = chunks[i];
+               const char* from = payload.data() + chunk.offset;
+               if(chunk.codec != FsGridCompression::none) {
+                  chunk.bytes = encoded[i].size();
+                  from = encoded[i].data();
+               }
+               chunk.offset = bytes;
+               bytes += (chunk.bytes + alignment - 1) / alignment * alignment;
+               compressed.resize(bytes);
+               std::copy(from, from + chunk.bytes, compressed.data() + chunk.offset);
+               std::vector<char>().swap(encoded[i]);
+            }
+            payload.swap(compressed);
+         }
+
+         // Place our chunks and index entries after those of the lower ranks
+         MPI_Comm comm = topology->getComm();
+         uint64_t counts[2] = {chunks.size(), bytes};
+         uint64_t before[2] = {0, 0};
+         uint64_t totals[2];
+         MPI_Exscan(counts, before, 2, MPI_UINT64_T, MPI_SUM, comm);
+         MPI_Allreduce(counts, totals, 2, MPI_UINT64_T, MPI_SUM, comm);
+         if(rank == 0) {
+            before[0] = before[1] = 0;
+         }
+         const uint64_t indexOffset = sizeof(FsGridChunkedHeader);
+         const uint64_t dataOffset = (indexOffset + totals[0] * sizeof(FsGridChunkEntry) + alignment - 1) / alignment * alignment;
+         for(FsGridChunkEntry& chunk : chunks) {
+            chunk.offset += dataOffset + before[1];
+         }
+
+         MPI_File file = FsGridCheckpointIO::open(path, MPI_MODE_CREATE | MPI_MODE_WRONLY, comm);
+         MPI_File_set_size(file, 0);
+         if(rank == 0) {
+            FsGridChunkedHeader header = {};
+            std::copy(FsGridChunkedHeader::magicValue, FsGridChunkedHeader::magicValue + 8, header.magic);
+            header.version = FsGridChunkedHeader::currentVersion;
+            header.cellBytes = sizeof(T);
+            header.components = components;
+            header.componentBytes = sizeof(value_type);
+            const std::array<double, 3> spacing = {DX, DY, DZ};
+            for(int i=0; i<3; i++) {
+               header.globalSize[i] = globalSize[i];
+               header.spacing[i] = spacing[i];
+               header.physicalGlobalStart[i] = physicalGlobalStart[i];
+            }
+            header.numChunks = totals[0];
+            header.indexOffset = indexOffset;
+            header.alignment = alignment;
+            header.quantum = 2 * compression.errorBound;
+            FsGridCheckpointIO::check(MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE), path);
+         }
+         // Payloads are whole multiples of the alignment, which keeps the counts within int
+         MPI_Datatype block;
+         MPI_Type_contiguous(alignment, MPI_BYTE, &block);
+         MPI_Type_commit(&block);
+         int status = MPI_File_write_at_all(file, indexOffset + before[0] * sizeof(FsGridChunkEntry), chunks.data(),
+               chunks.size() * sizeof(FsGridChunkEntry), MPI_BYTE, MPI_STATUS_IGNORE);
+         if(status == MPI_SUCCESS) {
+            status = MPI_File_write_at_all(file, dataOffset + before[1], payload.data(), bytes / alignment, block, MPI_STATUS_IGNORE);
+         }
+         MPI_Type_free(&block);
+         MPI_File_close(&file);
+         FsGridCheckpointIO::check(status, path);
+      }
+
+      /*! Gather components of a box of cells into a contiguous array on one task, in x-fastest order
+       * with numComponents values per cell. Only the tasks owning part of the box and the root task take
+       * part: each of them packs its own sub-box, and the root receives them straight into place.
+       * Non-FS tasks return at once.
+       * \param start Global coordinates of the box's first cell
+       * \param boxSize Size of the box, in cells
+       * \param firstComponent First component to extract
+       * \param numComponents Number of consecutive components to extract
+       * \param buffer Destination on the root task, with room for numComponents values for every cell of the box
+       * \param root Rank of the receiving task in this grid's communicator
+       */
+      template<typename Real> void extractBox(const std::array<FsIndex_t, 3>& start, const std::array<FsIndex_t, 3>& boxSize,
+            int firstComponent, int numComponents, Real* buffer, int root = 0) {
+         static_assert(std::is_same<Real, typename FsGridCellTraits<T>::value_type>::value,
+               "FsGrid::extractBox() needs buffers of the cells' value type");
+         if(rank == -1) {
+            return;
+         }
+         bool valid = root >= 0 && root < getSize() && firstComponent >= 0 && numComponents > 0
+            && firstComponent + numComponents <= FsGridCellTraits<T>::components;
+         for(int i=0; i<3; i++) {
+            valid = valid && start[i] >= 0 && boxSize[i] > 0 && (FsSize_t)(start[i] + boxSize[i]) <= globalSize[i];
+         }
+         if(!valid) {
+            if(rank == 0) {
+               std::cerr << "FsGrid can't extract components " << firstComponent << " to " << firstComponent + numComponents
+                  << " of the box at (" << start[0] << " " << start[1] << " " << start[2] << ") of size (" << boxSize[0] << " "
+                  << boxSize[1] << " " << boxSize[2] << ") to rank " << root << "." << std::endl;
+            }
+            throw std::runtime_error("FsGrid extraction out of range");
+         }
+
+         // Our own part of the box
+         std::array<FsIndex_t, 3> lower, size;
+         bool intersects = true;
+         for(int i=0; i<3; i++) {
+            lower[i] = std::max(start[i], localStart[i]);
+            size[i] = std::min(start[i] + boxSize[i], localStart[i] + localSize[i]) - lower[i];
+            intersects = intersects && size[i] > 0;
+         }
+         if(!intersects && rank != root) {
+            return;
+         }
+
+         MPI_Comm comm = topology->getComm();
+         MPI_Datatype cellType;
+         MPI_Type_contiguous(numComponents * sizeof(Real), MPI_BYTE, &cellType);
+         MPI_Type_commit(&cellType);
+         std::vector<MPI_Request> receives;
+         if(rank == root) {
+            // Receive every other task's part into its place in the box
+            std::vector<BoxTransfer> parts;
+            computeBoxTransfers(globalSize, start, boxSize, ntasksPerDim, parts);
+            for(const BoxTransfer& part : parts) {
+               if(part.task == rank) {
+                  continue;
+               }
+               // Subarrays are given in (z,y,x) order
+               const std::array<int, 3> boxSizes = {boxSize[2], boxSize[1], boxSize[0]};
+               const std::array<int, 3> sizes = {part.size[2], part.size[1], part.size[0]};
+               const std::array<int, 3> starts = {part.localStart[2], part.localStart[1], part.localStart[0]};
+               MPI_Datatype partType;
+               MPI_Type_create_subarray(3, boxSizes.data(), sizes.data(), starts.data(), MPI_ORDER_C, cellType, &partType);
+               MPI_Type_commit(&partType);
+               receives.push_back(MPI_REQUEST_NULL);
+               MPI_Irecv(buffer, 1, partType, part.task, extractionTag, comm, &receives.back());
+               MPI_Type_free(&partType);
+            }
+         }
+
+         if(intersects) {
+            // The root packs its part in place, everyone else packs it contiguously
+            std::vector<Real> packed;
+            Real* to;
+            std::array<size_t, 2> strides;
+            if(rank == root) {
+               to = buffer + (((size_t)(lower[2] - start[2]) * boxSize[1] + lower[1] - start[1]) * boxSize[0] + lower[0] - start[0])
+                  * numComponents;
+               strides = {(size_t)boxSize[0] * numComponents, (size_t)boxSize[0] * boxSize[1] * numComponents};
+            } else {
+               packed.resize((size_t)size[0] * size[1] * size[2] * numComponents);
+               to = packed.data();
+               strides = {(size_t)size[0] * numComponents, (size_t)size[0] * size[1] * numComponents};
+            }
+            for(FsIndex_t z=0; z<size[2]; z++) {
+               for(FsIndex_t y=0; y<size[1]; y++) {
+                  const LocalID row = LocalIDForCoords(lower[0] - localStart[0], lower[1] - localStart[1] + y, lower[2] - localStart[2] + z);
+                  Real* values = to + z * strides[1] + y * strides[0];
+                  for(FsIndex_t x=0; x<size[0]; x++) {
+                     const CellPointer p = cellPointer(row + x);
+                     for(int c=0; c<numComponents; c++) {
+                        *values++ = (*p)[firstComponent + c];
+                     }
+                  }
+               }
+            }
+            if(rank != root) {
+               MPI_Send(packed.data(), size[0] * size[1] * size[2], cellType, root, extractionTag, comm);
+            }
+         }
+         MPI_Waitall(receives.size(), receives.data(), MPI_STATUSES_IGNORE);
+         MPI_Type_free(&cellType);
+      }
+
+      /*! Gather components of the plane of cells at the given global index along axis onto one task,
+       * as an array over the other two dimensions, lower dimension fastest (see extractBox()).
+       * Only the tasks the plane passes through and the root task take part.
+       * \param axis Dimension normal to the plane (0, 1 or 2)
+       * \param index Global coordinate of the plane along axis, in cells
+       * \param firstComponent First component to extract
+       * \param numComponents Number of consecutive components to extract
+       * \param buffer Destination on the root task, with room for numComponents values for every cell of the plane
+       * \param root Rank of the receiving task in this grid's communicator
+       */
+      template<typename Real> void extractSlice(int axis, FsIndex_t index, int firstComponent, int numComponents,
+            Real* buffer, int root = 0) {
+         checkAxis(axis);
+         std::array<FsIndex_t, 3> start = {0, 0, 0};
+         std::array<FsIndex_t, 3> size = {(FsIndex_t)globalSize[0], (FsIndex_t)globalSize[1], (FsIndex_t)globalSize[2]};
+         start[axis] = index;
+         size[axis] = 1;
+         extractBox(start, size, firstComponent, numComponents, buffer, root);
+      }
+
+      /*! Gather components of the line of cells along axis through the given global cell onto one task
+       * (see extractBox()). Only the tasks the line passes through and the root task take part.
+       * \param axis Dimension along the line (0, 1 or 2)
+       * \param through Global coordinates of a cell on the line; its coordinate along axis is ignored
+       * \param firstComponent First component to extract
+       * \param numComponents Number of consecutive components to extract
+       * \param buffer Destination on the root task, with room for numComponents values for every cell of the line
+       * \param root Rank of the receiving task in this grid's communicator
+       */
+      template<typename Real> void extractLine(int axis, const std::array<FsIndex_t, 3>& through, int firstComponent,
+            int numComponents, Real* buffer, int root = 0) {
+         checkAxis(axis);
+         std::array<FsIndex_t, 3> start = through;
+         std::array<FsIndex_t, 3> size = {1, 1, 1};
+         start[axis] = 0;
+         size[axis] = globalSize[axis];
+         extractBox(start, size, firstComponent, numComponents, buffer, root);
+      }
+
+      /*! Write components of a plane of cells (see extractSlice()) into a checkpoint file of a grid
+       * that has the plane's size and physical extent, and a cell of numComponents values. Rank 0
+       * of this grid gathers the plane and writes the file, so it can be read back with
+       * readCheckpoint() on a grid of that shape, or directly after the header. Only the tasks the
+       * plane passes through and rank 0 take part. An existing file is overwritten.
+       * \param path Name of the file
+       * \param axis Dimension normal to the plane (0, 1 or 2)
+       * \param index Global coordinate of the plane along axis, in cells
+       * \param firstComponent First component to write
+       * \param numComponents Number of consecutive components to write
+       */
+      void writeSlice(const std::string& path, int axis, FsIndex_t index, int firstComponent, int numComponents) {
+         typedef typename FsGridCellTraits<T>::value_type value_type;
+         if(rank == -1) {
+            return;
+         }
+         checkAxis(axis);
+         std::array<FsSize_t, 3> size = globalSize;
+         size[axis] = 1;
+         const size_t cells = (size_t)size[0] * size[1] * size[2];
+         std::vector<value_type> plane;
+         if(rank == 0) {
+            plane.resize(cells * std::max(numComponents, 0));
+         }
+         extractSlice(axis, index, firstComponent, numComponents, plane.data());
+         if(rank != 0) {
+            return;
+         }
+
+         std::array<double, 3> spacing = {DX, DY, DZ};
+         std::array<double, 3> start = physicalGlobalStart;
+         start[axis] += index * spacing[axis];
+         const FsGridCheckpointHeader header = FsGridCheckpointIO::makeHeader(numComponents * sizeof(value_type), size, spacing, start);
+         MPI_File file = FsGridCheckpointIO::open(path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_COMM_SELF);
+         MPI_File_set_size(file, 0);
+         int status = MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+         if(status == MPI_SUCCESS) {
+            // Written in cells, so that the count fits into an int
+            MPI_Datatype cellType;
+            MPI_Type_contiguous(numComponents * sizeof(value_type), MPI_BYTE, &cellType);
+            MPI_Type_commit(&cellType);
+            status = MPI_File_write_at(file, header.dataOffset, plane.data(), cells, cellType, MPI_STATUS_IGNORE);
+            MPI_Type_free(&cellType);
+         }
+         MPI_File_close(&file);
+         FsGridCheckpointIO::check(status, path);
+      }
+
+      /*! Get the physical coordinates in the global simulation space for
+       * the given cell.
+       *
+       * \param x local x-Coordinate, in cells
+       * \param y local y-Coordinate, in cells
+       * \param z local z-Coordinate, in cells
+       */
+      std::array<double, 3> getPhysicalCoords(int x, int y, int z) {
+         std::array<double, 3> coords;
+         coords[0] = physicalGlobalStart[0] + (localStart[0]+x)*DX;
+         coords[1] = physicalGlobalStart[1] + (localStart[1]+y)*DY;
+         coords[2] = physicalGlobalStart[2] + (localStart[2]+z)*DZ;
+
+         return coords;
+      }
+
+      /*! Debugging output helper function. Allows for nicely formatted printing
+       * of grid contents. Since the grid data format is varying, the actual
+       * printing should be done in a lambda passed to this function. Example usage
+       * to plot |B|:
+       *
+       * perBGrid.debugOutput([](const std::array<Real, fsgrids::bfield::N_BFIELD>& a)->void{
+       *     cerr << sqrt(a[0]*a[0]+a[1]*a[1]+a[2]*a[2]) << ", ";
+       * });
+       *
+       * \param func Function pointer (or lambda) which is called with a cell reference,
+       * in order. Use std::cerr in it to print desired value.
+       */
+      void debugOutput(void (func)(const T&)) {
+         int xmin=0,xmax=1;
+         int ymin=0,ymax=1;
+         int zmin=0,zmax=1;
+         if(localSize[0] > 1) {
+            xmin = -stencil; xmax = localSize[0]+stencil;
+         }
+         if(localSize[1] > 1) {
+            ymin = -stencil; ymax = localSize[1]+stencil;
+         }
+         if(localSize[2] > 1) {
+            zmin = -stencil; zmax = localSize[2]+stencil;
+         }
+         for(int z=zmin; z<zmax; z++) {
+            for(int y=ymin; y<ymax; y++) {
+               for(int x=xmin; x<xmax; x++) {
+                  func(*get(x,y,z));
+               }
+               std::cerr << std::endl;
+            }
+            std::cerr << " - - - - - - - - " << std::endl;
+         }
+      }
+
+      /*! Get the rank of this CPU in the FsGrid communicator */
+      int getRank() {
+        return rank;
+      }
+
+      /*! Get the number of ranks in the FsGrid communicator */
+      int getSize() {
+        return ntasksPerDim[0] * ntasksPerDim[1] * ntasksPerDim[2];
+      }
+
+      /*! Get in which directions, if any, this grid is periodic */
+      std::array<bool, 3>& getPeriodic() {
+        return periodic;
+      }
+
+      /*! Perform an MPI_Allreduce with this grid's internal communicator
+       * Function syntax is identical to MPI_Allreduce, except the final (communicator
+       * argument will not be needed) */
+      int Allreduce(void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op) {
+         
+         // If a normal FS-rank
+         if(rank != -1){
+            return MPI_Allreduce(sendbuf, recvbuf, count, datatype, op, topology->getComm());
+         }
+         // If a non-FS rank, no need to communicate
+         else{
+            int datatypeSize;
+            MPI_Type_size(datatype, &datatypeSize);
+            for(int i = 0; i < count * datatypeSize; ++i)
+               ((char*)recvbuf)[i] = ((char*)sendbuf)[i];
+            return MPI_ERR_RANK; // This is ok for a non-FS rank
+         }
+      }
+
+      /*! Start an MPI_Iallreduce with this grid's internal communicator
+       * Function syntax is identical to MPI_Iallreduce, except the communicator
+       * argument will not be needed. Like Allreduce(), non-FS tasks just copy sendbuf
+       * to recvbuf, get MPI_REQUEST_NULL and MPI_ERR_RANK. */
+      int Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Request* request) {
+         if(rank != -1) {
+            return MPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, topology->getComm(), request);
+         } else {
+            int datatypeSize;
+            MPI_Type_size(datatype, &datatypeSize);
+            std::copy((const char*)sendbuf, (const char*)sendbuf + count * datatypeSize, (char*)recvbuf);
+            *request = MPI_REQUEST_NULL;
+            return MPI_ERR_RANK; // This is ok for a non-FS rank
+         }
+      }
 
-                  /*
-                   * Figure out the coordinates of the neighbours in all three
-                   * directions
-                   */
-                  neighPosition[0]=taskPosition[0]+x;
-                  if(isPeriodic[0]) {
-                     neighPosition[0] += ntasksPerDim[0];
-                     neighPosition[0] %= ntasksPerDim[0];
-                  }
+      /*! Start reducing several values of an arithmetic type over this grid's tasks with op, e.g.
+       * the local timestep limits, and return a handle to collect the result from later:
+       *
+       * auto limits = grid.Iallreduce(std::array<double, 2>{dtLocal, -vMaxLocal}, MPI_MIN);
+       * ... local work ...
+       * const double dt = limits.wait()[0];
+       *
+       * The values of non-FS tasks don't take part, but all tasks of the communicator the grid
+       * was built from get the result: if there are non-FS tasks, wait() broadcasts it to them,
+       * and is then collective over that communicator.
+       */
+      template<typename V, size_t N> FsGridAllreduceFuture<V, N> Iallreduce(const std::array<V, N>& values, MPI_Op op) {
+         int parentSize;
+         MPI_Comm_size(topology->getParentComm(), &parentSize);
+         const bool auxTasks = parentSize > ntasksPerDim[0] * ntasksPerDim[1] * ntasksPerDim[2];
+         return FsGridAllreduceFuture<V, N>(values, op, rank != -1 ? topology->getComm() : MPI_COMM_NULL,
+               auxTasks ? topology->getParentComm() : MPI_COMM_NULL);
+      }
 
-                  neighPosition[1]=taskPosition[1]+y;
-                  if(isPeriodic[1]) {
-                     neighPosition[1] += ntasksPerDim[1];
-                     neighPosition[1] %= ntasksPerDim[1];
-                  }
+      //! Start reducing a single value, see above; the result is wait()[0]
+      template<typename V, typename = std::enable_if_t<std::is_arithmetic<V>::value>>
+      FsGridAllreduceFuture<V, 1> Iallreduce(V value, MPI_Op op) {
+         return Iallreduce(std::array<V, 1>{value}, op);
+      }
 
-                  neighPosition[2]=taskPosition[2]+z;
-                  if(isPeriodic[2]) {
-                     neighPosition[2] += ntasksPerDim[2];
-                     neighPosition[2] %= ntasksPerDim[2];
-                  }
+      //! The topology of this grid, to construct further grids on
+      std::shared_ptr<FsGridTopology> getTopology() {
+         return topology;
+      }
 
-                  /*
-                   * If those coordinates exist, figure out the responsible CPU
-                   * and store its rank
-                   */
-                  if(neighPosition[0]>=0 && neighPosition[0]<ntasksPerDim[0] && neighPosition[1]>=0
-                        && neighPosition[1]<ntasksPerDim[1] && neighPosition[2]>=0 && neighPosition[2]<ntasksPerDim[2]) {
+      /*! Get the decomposition array*/
+      std::array<Task_t, 3>& getDecomposition(){
+         return ntasksPerDim;
+      }
 
-                     // Calculate the rank
-                     int neighRank;
-                     status = MPI_Cart_rank(comm3d, neighPosition.data(), &neighRank);
-                     if(status != MPI_SUCCESS) {
-                        std::cerr << "Rank " << rank << " can't determine neighbour rank at position [";
-                        for(int i=0; i<3; i++) {
-                           std::cerr << neighPosition[i] << ", ";
-                        }
-                        std::cerr << "]" << std::endl;
-                     }
+      /*! Physical grid spacing and physical coordinate space start.
+       * TODO: Should this be private and have accesor-functions?
+       */
+      double DX,DY,DZ;
+      std::array<double,3> physicalGlobalStart;
 
-                     // Forward lookup table
-                     neighbour[(x+1)*9+(y+1)*3+(z+1)]=neighRank;
+   private:
+      //! Decomposition and MPI Cartesian communicator used in this grid, possibly shared with other grids
+      std::shared_ptr<FsGridTopology> topology;
+      int rank; //!< This task's rank in the communicator
+      std::vector<MPI_Request> requests;
+      uint numRequests;
+
+      std::array<int, 27> neighbour; //!< Tasks of the 26 neighbours (plus ourselves)
+      FsGridTaskLookup taskLookup; //!< Closed-form lookup of cell owners
+
+      // We have, fundamentally, two different coordinate systems we're dealing with:
+      // 1) Task grid in the MPI_Cartcomm
+      std::array<Task_t, 3> ntasksPerDim; //!< Number of tasks in each direction
+      std::array<Task_t, 3> taskPosition; //!< This task's position in the 3d task grid
+      // 2) Cell numbers in global and local view
+
+      std::array<bool, 3> periodic; //!< Information about whether a given direction is periodic
+      std::array<FsSize_t, 3> globalSize; //!< Global size of the simulation space, in cells
+      std::array<FsIndex_t, 3> localSize;  //!< Local size of simulation space handled by this task (without ghost cells)
+      std::array<FsIndex_t, 3> storageSize;  //!< Local size of simulation space handled by this task (including ghost cells and padding)
+      std::array<LocalID, 3> storageStride = {0, 0, 0}; //!< Distance between neighbouring cells in storage, zero for collapsed dimensions
+      std::array<FsIndex_t, 3> localStart; //!< Offset of the local
+                                          //!coordinate system against
+                                          //!the global one
+
+      std::array<MPI_Datatype, 27> neighbourSendType; //!< Datatype for sending data (owned by the topology)
+      std::array<MPI_Datatype, 27> neighbourReceiveType; //!< Datatype for receiving data (owned by the topology)
+
+      std::array<FsIndex_t, 3> tileSize = defaultTileSize; //!< Cache tile shape of the cell iteration functions
+
+      //! Call a cell iteration function with whichever cell argument it takes
+      template<typename F> inline decltype(auto) callCellFunction(F& func, int x, int y, int z, LocalID id) {
+         if constexpr (std::is_invocable_v<F&, int, int, int>) {
+            return func(x, y, z);
+         } else if constexpr (std::is_invocable_v<F&, int, int, int, CellPointer>) {
+            return func(x, y, z, cellPointer(id));
+         } else {
+#ifdef FSGRID_DEBUG
+            return func(x, y, z, typename FsGridView<T>::Cell{&storage[id], storageStride, {x, y, z}, localSize, stencil});
+#else
+            return func(x, y, z, typename FsGridView<T>::Cell{&storage[id], storageStride});
+#endif
+         }
+      }
+
+      //! Number of cache tiles of a box of cells in each dimension
+      std::array<FsIndex_t, 3> tileCounts(const std::array<FsIndex_t, 3>& size) const {
+         std::array<FsIndex_t, 3> ntiles;
+         for(int i=0; i<3; i++) {
+            ntiles[i] = (size[i] + tileSize[i] - 1) / tileSize[i];
+         }
+         return ntiles;
+      }
+
+      /*! Split a non-empty box of local cells into cache tiles, and call func(tile, low, high) for each,
+       * distributed over the threads of the executor. Tiles are numbered x-fastest.
+       */
+      template<typename F, typename Executor>
+      void forEachTile(const std::array<FsIndex_t, 3>& start, const std::array<FsIndex_t, 3>& size, F&& func, Executor&& executor) {
+         const std::array<FsIndex_t, 3> ntiles = tileCounts(size);
+         executor.parallelFor((size_t)ntiles[0] * ntiles[1] * ntiles[2], [&](size_t tile) {
+            const FsIndex_t tileIndex[3] = {(FsIndex_t)(tile % ntiles[0]), (FsIndex_t)(tile / ntiles[0] % ntiles[1]),
+               (FsIndex_t)(tile / ntiles[0] / ntiles[1])};
+            std::array<FsIndex_t, 3> low, high;
+            for(int i=0; i<3; i++) {
+               low[i] = start[i] + tileIndex[i] * tileSize[i];
+               high[i] = std::min(low[i] + tileSize[i], start[i] + size[i]);
+            }
+            func(tile, low, high);
+         });
+      }
 
-                     // Reverse lookup table
-                     if(neighRank >= 0 && neighRank < size) {
-                        neighbour_index[neighRank]=(char) ((x+1)*9+(y+1)*3+(z+1));
+      /*! Create the ghost datatype for a box of cells, given in (z,y,x)-ordered storage coordinates.
+       * With split layouts, the type covers one component, and its extent is the distance
+       * between components, so that sending several elements sends several components.
+       */
+      void createGhostType(const std::array<int,3>& swappedStorageSize, const std::array<int,3>& swappedSize,
+            const std::array<int,3>& swappedStart, MPI_Datatype element, MPI_Datatype* type) {
+         if constexpr (!Layout::tiled) {
+            MPI_Type_create_subarray(3, swappedStorageSize.data(), swappedSize.data(), swappedStart.data(),
+                  MPI_ORDER_C, element, type);
+         } else {
+            // Tiles break the rows of the box into runs of at most W contiguous values
+            const int components = FsGridCellTraits<T>::components;
+            std::vector<int> blockLengths, displacements;
+            for(int z=swappedStart[0]; z<swappedStart[0]+swappedSize[0]; z++) {
+               for(int y=swappedStart[1]; y<swappedStart[1]+swappedSize[1]; y++) {
+                  for(int x=swappedStart[2]; x<swappedStart[2]+swappedSize[2]; x++) {
+                     const LocalID id = x + (LocalID)swappedStorageSize[2] * (y + (LocalID)swappedStorageSize[1] * z);
+                     const int offset = Layout::offset(id, 0, components, storageCells);
+                     if(!displacements.empty() && displacements.back() + blockLengths.back() == offset) {
+                        blockLengths.back()++;
+                     } else {
+                        displacements.push_back(offset);
+                        blockLengths.push_back(1);
                      }
-                  } else {
-                     neighbour[(x+1)*9+(y+1)*3+(z+1)]=MPI_PROC_NULL;
                   }
                }
             }
+            MPI_Datatype runs;
+            MPI_Type_indexed(displacements.size(), blockLengths.data(), displacements.data(), element, &runs);
+            MPI_Type_create_resized(runs, 0, Layout::offset(0, 1, components, storageCells) * (sizeof(T) / components), type);
+            MPI_Type_free(&runs);
+         }
+      }
+
+      /*! Collectively write (or read) our interior cells at their place in the global x-fastest cell
+       * array that starts at byte offset of the file. Contiguous layouts transfer straight from
+       * storage through a subarray type, others go through a packed copy of the box.
+       */
+      void transferCheckpointCells(MPI_File file, MPI_Offset offset, const std::string& path, bool write) {
+         MPI_Datatype cellType;
+         MPI_Type_contiguous(sizeof(T), MPI_BYTE, &cellType);
+         MPI_Type_commit(&cellType);
+         FsGridCheckpointIO::setView(file, offset, cellType, globalSize, localStart, localSize, path);
+
+         int status;
+         if constexpr (Layout::cellsContiguous && !Layout::tiled) {
+            // Our interior cells within storage, including its ghost cells and padding
+            MPI_Datatype memoryType;
+            std::array<int, 3> sizes = {localSize[0], localSize[1], localSize[2]};
+            swapArray(sizes);
+            std::array<int, 3> storageSizes = {(int)storageSize[0], (int)storageSize[1], (int)storageSize[2]};
+            std::array<int, 3> storageStarts;
+            for(int i=0; i<3; i++) {
+               storageStarts[i] = storageSize[i] == 1 ? 0 : stencil;
+            }
+            swapArray(storageSizes);
+            swapArray(storageStarts);
+            MPI_Type_create_subarray(3, storageSizes.data(), sizes.data(), storageStarts.data(), MPI_ORDER_C, cellType, &memoryType);
+            MPI_Type_commit(&memoryType);
+            if(write) {
+               status = MPI_File_write_all(file, storage, 1, memoryType, MPI_STATUS_IGNORE);
+            } else {
+               status = MPI_File_read_all(file, storage, 1, memoryType, MPI_STATUS_IGNORE);
+            }
+            MPI_Type_free(&memoryType);
+         } else {
+            const std::array<FsIndex_t, 3> origin = {0, 0, 0};
+            std::vector<T> buffer((size_t)localSize[0] * localSize[1] * localSize[2]);
+            if(write) {
+               packBox(origin, localSize, buffer.data());
+               status = MPI_File_write_all(file, buffer.data(), buffer.size(), cellType, MPI_STATUS_IGNORE);
+            } else {
+               status = MPI_File_read_all(file, buffer.data(), buffer.size(), cellType, MPI_STATUS_IGNORE);
+               unpackBox(origin, localSize, buffer.data());
+            }
+         }
+         MPI_Type_free(&cellType);
+         FsGridCheckpointIO::check(status, path);
+      }
+
+      //! Throw unless axis names a dimension
+      void checkAxis(int axis) const {
+         if(axis < 0 || axis > 2) {
+            std::cerr << "FsGrid: axis " << axis << " doesn't exist." << std::endl;
+            throw std::runtime_error("FsGrid axis out of range");
+         }
+      }
+
+      static const int extractionTag = 9278;
+
+      //! Whether dimension i is known at compile time to be collapsed
+      static constexpr bool collapsedAtCompileTime(int i) {
+         if constexpr (Layout::fixedDimensions) {
+            return !Layout::extends[i];
+         } else {
+            return false;
+         }
+      }
+
+      //! Number of MPI ghost datatype elements per cell
+      static constexpr int componentsPerElement() {
+         if constexpr (Layout::cellsContiguous) {
+            return 1;
+         } else {
+            return FsGridCellTraits<T>::components;
+         }
+      }
+
+      CellPointer cellPointer(LocalID id) {
+         if constexpr (Layout::cellsContiguous) {
+            return &storage[id];
+         } else {
+            return CellPointer(reinterpret_cast<typename FsGridCellTraits<T>::value_type*>(storage), id, storageCells);
          }
+      }
 
+      //! Allocate (or attach) the cell storage and build the ghost cell datatypes, once the decomposition is known
+      template<typename Executor>
+      void setupStorage(FsGridArena* arena, T* externalStorage, size_t externalCells, Executor& firstTouch) {
          // Allocate local storage array
+         // Collapsed dimensions are only one cell thick, others hold the local domain + 2* size for
+         // the ghost cell stencil, padded to whole tiles for tiled layouts and against cache conflicts
+         // for padded ones. The task lookup makes the same calculation for all tasks.
+         const std::array<bool, 3> collapsed = {globalSize[0] <= 1, globalSize[1] <= 1, globalSize[2] <= 1};
          size_t totalStorageSize=1;
          for(int i=0; i<3; i++) {
-            if(globalSize[i] <= 1) {
-               // Collapsed dimension => only one cell thick
-               storageSize[i] = 1;
-            } else {
-               // Size of the local domain + 2* size for the ghost cell stencil
-               storageSize[i] = (localSize[i] + stencil*2);
-            }
+            storageSize[i] = calcStorageSize(i, localSize[i] + stencil*2, storageSize[0], collapsed,
+               Layout::rowAlignment, Layout::conflictStride, sizeof(T));
             totalStorageSize *= storageSize[i];
          }
-         data.resize(totalStorageSize);
+         storageStride[0] = globalSize[0] > 1 ? 1 : 0;
+         storageStride[1] = globalSize[1] > 1 ? storageSize[0] : 0;
+         storageStride[2] = globalSize[2] > 1 ? storageSize[0] * storageSize[1] : 0;
+         if(externalStorage != nullptr) {
+            setExternalStorage(externalStorage, externalCells, totalStorageSize);
+         } else if(arena != nullptr) {
+            storage = arena->allocate<T>(totalStorageSize);
+            storageCells = totalStorageSize;
+            initializeStorage(firstTouch);
+         } else {
+            data.resize(totalStorageSize);
+            storage = data.data();
+            storageCells = data.size();
+            if constexpr (FsGridDefaultInitialising<Allocator>::value) {
+               initializeStorage(firstTouch);
+            }
+         }
+
+         // Ghost datatypes only depend on the cell size, layout and stencil,
+         // so grids of the same kind on one topology share them.
+         const std::array<size_t, 7> ghostTypeKey = {sizeof(T), (size_t)componentsPerElement(), (size_t)stencil,
+            (size_t)Layout::rowAlignment, (size_t)Layout::conflictStride, Layout::cellsContiguous, Layout::tiled};
+         const FsGridTopology::GhostTypes& ghostTypes = topology->getGhostTypes(ghostTypeKey,
+            [this](std::array<MPI_Datatype, 27>& sendTypes, std::array<MPI_Datatype, 27>& receiveTypes) {
+               createGhostTypes(sendTypes, receiveTypes);
+            });
+         neighbourSendType = ghostTypes.send;
+         neighbourReceiveType = ghostTypes.receive;
+      }
 
+      //! Create the (uncommitted) send and receive ghost datatypes of all neighbour directions
+      void createGhostTypes(std::array<MPI_Datatype, 27>& sendTypes, std::array<MPI_Datatype, 27>& receiveTypes) {
+         // Ghost datatypes describe one cell's worth of data per element; with split
+         // layouts, that's a single component, and the exchange sends all components.
          MPI_Datatype mpiTypeT;
-         MPI_Type_contiguous(sizeof(T), MPI_BYTE, &mpiTypeT);
+         MPI_Type_contiguous(sizeof(T) / componentsPerElement(), MPI_BYTE, &mpiTypeT);
 
          // Compute send and receive datatypes
          //loop through the shifts in the different directions
@@ -496,8 +3766,8 @@ template <typename T, int stencil> class FsGrid : public FsGridTools{
                      (storageSize[2] == 1 && z!= 0 ) ||
                      (x == 0 && y == 0 && z == 0)){
                      //skip flat dimension for 2 or 1D simulations, and self
-                     neighbourSendType[shiftId] = MPI_DATATYPE_NULL;
-                     neighbourReceiveType[shiftId] = MPI_DATATYPE_NULL;
+                     sendTypes[shiftId] = MPI_DATATYPE_NULL;
+                     receiveTypes[shiftId] = MPI_DATATYPE_NULL;
                      continue;
                   }
 
@@ -508,15 +3778,15 @@ template <typename T, int stencil> class FsGrid : public FsGridTools{
                   if( x == 0 || x == -1 )
                      subarrayStart[0] = stencil;
                   else if (x == 1)
-                     subarrayStart[0] = storageSize[0] - 2 * stencil;
+                     subarrayStart[0] = localSize[0];
                   if( y == 0 || y == -1 )
                      subarrayStart[1] = stencil;
                   else if (y == 1)
-                     subarrayStart[1] = storageSize[1] - 2 * stencil;
+                     subarrayStart[1] = localSize[1];
                   if( z == 0 || z == -1 )
                      subarrayStart[2] = stencil;
                   else if (z == 1)
-                     subarrayStart[2] = storageSize[2] - 2 * stencil;
+                     subarrayStart[2] = localSize[2];
                   
                   for(int i = 0;i < 3; i++)
                      if(storageSize[i] == 1) 
@@ -526,635 +3796,1297 @@ template <typename T, int stencil> class FsGrid : public FsGridTools{
                   swapArray(swappedStorageSize);
                   swapArray(subarraySize);
                   swapArray(subarrayStart);                  
-                  MPI_Type_create_subarray(3,
-                                           swappedStorageSize.data(),
-                                           subarraySize.data(),
-                                           subarrayStart.data(),
-                                           MPI_ORDER_C,
-                                           mpiTypeT,
-                                           &(neighbourSendType[shiftId]) );
+                  createGhostType(swappedStorageSize, subarraySize, subarrayStart, mpiTypeT, &(sendTypes[shiftId]));
                   
                   if(x == 1 )
                      subarrayStart[0] = 0;
                   else if (x == 0)
                      subarrayStart[0] = stencil;
                   else if (x == -1)
-                     subarrayStart[0] = storageSize[0] -  stencil;
+                     subarrayStart[0] = localSize[0] + stencil;
                   if(y == 1 )
                      subarrayStart[1] = 0;
                   else if (y == 0)
                      subarrayStart[1] = stencil;
                   else if (y == -1)
-                     subarrayStart[1] = storageSize[1] -  stencil;
+                     subarrayStart[1] = localSize[1] + stencil;
                   if(z == 1 )
                      subarrayStart[2] = 0;
                   else if (z == 0)
                      subarrayStart[2] = stencil;
                   else if (z == -1)
-                     subarrayStart[2] = storageSize[2] -  stencil;
+                     subarrayStart[2] = localSize[2] + stencil;
                   for(int i = 0;i < 3; i++)
                      if(storageSize[i] == 1) 
                         subarrayStart[i] = 0;
                   
                   swapArray(subarrayStart);                  
-                  MPI_Type_create_subarray(3,
-                                           swappedStorageSize.data(),
-                                           subarraySize.data(),
-                                           subarrayStart.data(),
-                                           MPI_ORDER_C,
-                                           mpiTypeT,
-                                           &(neighbourReceiveType[shiftId]));
+                  createGhostType(swappedStorageSize, subarraySize, subarrayStart, mpiTypeT, &(receiveTypes[shiftId]));
                   
                }
             }
          }
-         
-         for(int i=0;i<27;i++){
-            if(neighbourReceiveType[i] != MPI_DATATYPE_NULL)
-               MPI_Type_commit(&(neighbourReceiveType[i]));
-            if(neighbourSendType[i] != MPI_DATATYPE_NULL)
-               MPI_Type_commit(&(neighbourSendType[i]));
+         MPI_Type_free(&mpiTypeT);
+      }
+
+      /*! Value-initialise the (so far untouched) storage in parallel, in contiguous blocks of
+       * z-planes (y-planes for 2D grids in the xy-plane), like the static partitioning of the
+       * cell iteration functions, so that first touch places pages close to their users.
+       */
+      template<typename Executor>
+      void initializeStorage(Executor& executor) {
+         int dim = 2;
+         while(dim > 0 && storageSize[dim] <= 1) {
+            dim--;
          }
+         const size_t planes = storageSize[dim];
+         const size_t planeCells = storageCells / planes;
+         T* cells = storage;
+         executor.parallelFor(planes, [=](size_t plane) {
+            std::fill(cells + plane * planeCells, cells + (plane + 1) * planeCells, T());
+         });
       }
 
-      std::vector<T>& getData(){
-         return this->data;
+      void setExternalStorage(T* buffer, size_t bufferCells, size_t requiredCells) {
+         if(bufferCells < requiredCells) {
+            std::cerr << "FsGrid external storage of " << bufferCells << " cells is too small, "
+               << requiredCells << " cells needed on rank " << rank << "." << std::endl;
+            throw std::runtime_error("FsGrid external storage too small");
+         }
+         storage = buffer;
+         storageCells = requiredCells;
       }
 
-      void copyData(FsGrid &other){
-         this->data = other.getData(); // Copy assignment
+      //! Owned storage of field data, unless external storage is used
+      std::vector<T, Allocator> data;
+      T* storage = nullptr; //!< Cell storage in use, either data's or external
+      size_t storageCells = 0; //!< Number of cells in storage
+};
+
+/*! Several time levels of a field, each an FsGrid of identical decomposition.
+ * Level 0 is the current one. rotate() advances time by exchanging storage pointers,
+ * so that saving the previous time level doesn't need a copy of the grid.
+ *
+ * \param T datastructure containing the field in each cell
+ * \param stencil ghost cell width of each level
+ * \param Layout storage layout of the cells
+ * \param Allocator allocator of the cell storage
+ */
+template <typename T, int stencil, typename Layout = FsGridLayoutAoS, typename Allocator = FsGridAllocator<T>>
+class FsGridTimeLevels {
+   public:
+      typedef FsGrid<T, stencil, Layout, Allocator> Grid;
+
+      /*! Create the levels. Parameters after the number of levels as for the FsGrid constructor.
+       * \param levels Number of time levels, at least 1
+       */
+      FsGridTimeLevels(int levels, std::array<FsGridTools::FsSize_t,3> globalSize, MPI_Comm parent_comm,
+            std::array<bool,3> isPeriodic, const std::array<FsGridTools::Task_t, 3>& decomposition = {0,0,0},
+            bool verbose = false) {
+         if(levels < 1) {
+            std::cerr << "FsGridTimeLevels needs at least one time level" << std::endl;
+            throw std::runtime_error("FsGridTimeLevels without levels");
+         }
+         grids.reserve(levels);
+         grids.emplace_back(globalSize, parent_comm, isPeriodic, decomposition, verbose);
+         for(int i=1; i<levels; i++) {
+            grids.emplace_back(grids[0].getTopology());
+         }
       }
 
-      /*! 
-       *  MPI calls fail after the main program called MPI_Finalize(),
-       *  so this can be used instead of the destructor
-       *  Cleans up the cartesian communicator and datatypes
+      //! Grid of a time level, 0 being the current one and higher levels older ones
+      Grid& operator[](int level) {
+         return grids[level];
+      }
+
+      Grid& current() {
+         return grids[0];
+      }
+
+      int getNumLevels() const {
+         return grids.size();
+      }
+
+      /*! Advance to the next time level: each level's data moves one level back, and the
+       * storage of the oldest level is recycled as the new current level (keeping its stale contents).
        */
+      void rotate() {
+         for(size_t i=grids.size() - 1; i>0; i--) {
+            grids[i].swapStorage(grids[i-1]);
+         }
+      }
+
+      //! Exchange the ghost cells of one time level
+      void updateGhostCells(int level = 0) {
+         grids[level].updateGhostCells();
+      }
+
+      //! Copy the local (non-ghost) cells of one time level into another one, in parallel
+      template<typename Executor = FsGridOpenMP>
+      void copyLevel(int from, int to, Executor&& executor = Executor()) {
+         grids[to].copyInterior(grids[from], std::forward<Executor>(executor));
+      }
+
+      //! Finalize the grids of all levels, see FsGrid::finalize()
       void finalize() noexcept {
-         if (comm3d != MPI_COMM_NULL) {
-            MPI_Comm_free(&comm3d);
-            comm3d = MPI_COMM_NULL;
+         for(auto& grid : grids) {
+            grid.finalize();
          }
-         if(comm3d_aux != MPI_COMM_NULL) {
-            MPI_Comm_free(&comm3d_aux);
-            comm3d_aux = MPI_COMM_NULL;
+      }
+
+   private:
+      std::vector<Grid> grids;
+};
+
+/*! Reusable plan for copying the contents of one FsGrid into another one which covers
+ * the same global domain, but has a different domain decomposition or number of tasks
+ * (for example one grid on FSGRID_PROCS tasks, and another on all tasks).
+ *
+ * All overlaps between source and target task boxes are computed once at construction,
+ * so that execute() only packs, exchanges and unpacks the interior cells.
+ * Both grids have to be built from the same parent communicator, which is passed here.
+ *
+ * \param T datastructure containing the field in each cell, identical for both grids
+ */
+template <typename T> class FsGridTransferPlan : public FsGridTools {
+   public:
+
+      /*! Build the plan. This is collective over parent_comm.
+       * \param source Grid to copy data from
+       * \param target Grid to copy data into
+       * \param parent_comm The communicator both grids were created from
+       */
+      template<typename SourceGrid, typename TargetGrid>
+      FsGridTransferPlan(SourceGrid& source, TargetGrid& target, MPI_Comm parent_comm) {
+         if(source.getGlobalSize() != target.getGlobalSize()) {
+            std::cerr << "FsGridTransferPlan: source and target grids have different global sizes" << std::endl;
+            throw std::runtime_error("FsGridTransferPlan grid size mismatch");
          }
-         if(comm1d != MPI_COMM_NULL) {
-            MPI_Comm_free(&comm1d);
-            comm1d = MPI_COMM_NULL;
+         MPI_Comm_dup(parent_comm, &comm);
+         MPI_Comm_rank(comm, &rank);
+         MPI_Type_contiguous(sizeof(T), MPI_BYTE, &mpiTypeT);
+         MPI_Type_commit(&mpiTypeT);
+
+         // Cells we own in the source grid go to all overlapping target tasks,
+         // cells we own in the target grid come from all overlapping source tasks.
+         if(source.getRank() != -1) {
+            sendBufferSize = computeBoxTransfers(source.getGlobalSize(), source.getLocalStart(), source.getLocalSize(),
+                  target.getDecomposition(), sends);
          }
-         if(comm1d_aux != MPI_COMM_NULL) {
-            MPI_Comm_free(&comm1d_aux);
-            comm1d_aux = MPI_COMM_NULL;
+         if(target.getRank() != -1) {
+            receiveBufferSize = computeBoxTransfers(target.getGlobalSize(), target.getLocalStart(), target.getLocalSize(),
+                  source.getDecomposition(), receives);
          }
+         sendBuffer.resize(sendBufferSize);
+         receiveBuffer.resize(receiveBufferSize);
+         requests.reserve(sends.size() + receives.size());
+      }
 
-         for (auto& type : neighbourReceiveType) {
-            if (type != MPI_DATATYPE_NULL) {
-               MPI_Type_free(&type);
-               type = MPI_DATATYPE_NULL;
+      /*! Copy the interior cells of source into target. This is collective over the
+       * parent communicator, and the grids must have the layout the plan was built for.
+       * Ghost cells of target are not updated.
+       */
+      template<typename SourceGrid, typename TargetGrid>
+      void execute(SourceGrid& source, TargetGrid& target) {
+         requests.clear();
+         for(const BoxTransfer& r : receives) {
+            if(r.task != rank) {
+               requests.push_back(MPI_REQUEST_NULL);
+               MPI_Irecv(receiveBuffer.data() + r.offset, r.count, mpiTypeT, r.task, transferTag, comm, &requests.back());
             }
          }
-         for (auto& type : neighbourSendType) {
-            if (type != MPI_DATATYPE_NULL) {
-               MPI_Type_free(&type);
-               type = MPI_DATATYPE_NULL;
+
+         for(const BoxTransfer& s : sends) {
+            source.packBox(s.localStart, s.size, sendBuffer.data() + s.offset);
+            if(s.task != rank) {
+               requests.push_back(MPI_REQUEST_NULL);
+               MPI_Isend(sendBuffer.data() + s.offset, s.count, mpiTypeT, s.task, transferTag, comm, &requests.back());
             }
          }
-      }
 
-      /*!
-       *  If finalize() isn't called manually, object should be destroyed before MPI finalization
-       */
-      ~FsGrid() {
-         finalize();
-      }
+         copyOwnTransfers(sends, receives, rank, sendBuffer.data(), receiveBuffer.data());
 
-      friend void swap (FsGrid& first, FsGrid& second) noexcept {
-         using std::swap;
-         swap(first.DX, second.DX);
-         swap(first.DY, second.DY);
-         swap(first.DZ, second.DZ);
-         swap(first.physicalGlobalStart, second.physicalGlobalStart);
-         swap(first.comm1d, second.comm1d);
-         swap(first.comm1d_aux, second.comm1d_aux);
-         swap(first.comm3d, second.comm3d);
-         swap(first.comm3d_aux, second.comm3d_aux);
-         swap(first.rank, second.rank);
-         swap(first.requests, second.requests);
-         swap(first.numRequests, second.numRequests);
-         swap(first.neighbour, second.neighbour);
-         swap(first.neighbour_index, second.neighbour_index);
-         swap(first.ntasksPerDim, second.ntasksPerDim);
-         swap(first.taskPosition, second.taskPosition);
-         swap(first.periodic, second.periodic);
-         swap(first.globalSize, second.globalSize);
-         swap(first.localSize, second.localSize);
-         swap(first.storageSize, second.storageSize);
-         swap(first.localStart, second.localStart);
-         swap(first.neighbourSendType, second.neighbourSendType);
-         swap(first.neighbourReceiveType, second.neighbourReceiveType);
-         swap(first.data, second.data);
+         MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+         for(const BoxTransfer& r : receives) {
+            target.unpackBox(r.localStart, r.size, receiveBuffer.data() + r.offset);
+         }
       }
 
-      // Copy constructor
-      FsGrid(const FsGrid& other) : 
-         DX {other.DX},
-         DY {other.DY},
-         DZ {other.DZ},
-         physicalGlobalStart {other.physicalGlobalStart},
-         comm1d {MPI_COMM_NULL},
-         comm1d_aux {MPI_COMM_NULL},
-         comm3d {MPI_COMM_NULL},
-         comm3d_aux {MPI_COMM_NULL},
-         rank {other.rank}, 
-         requests {}, 
-         numRequests {0}, 
-         neighbour {other.neighbour},
-         neighbour_index {other.neighbour_index},
-         ntasksPerDim {other.ntasksPerDim},
-         taskPosition {other.taskPosition},
-         periodic {other.periodic},
-         globalSize {other.globalSize},
-         localSize {other.localSize},
-         storageSize {other.storageSize},
-         localStart {other.localStart},
-         neighbourSendType {},
-         neighbourReceiveType {},
-         data {other.data}
-      {
-         if (other.comm3d != MPI_COMM_NULL) {
-            MPI_Comm_dup(other.comm3d, &comm3d);
+      /*!
+       *  MPI calls fail after the main program called MPI_Finalize(),
+       *  so this can be used instead of the destructor
+       */
+      void finalize() noexcept {
+         if(mpiTypeT != MPI_DATATYPE_NULL) {
+            MPI_Type_free(&mpiTypeT);
+            mpiTypeT = MPI_DATATYPE_NULL;
          }
-
-         neighbourSendType.fill(MPI_DATATYPE_NULL);
-         neighbourReceiveType.fill(MPI_DATATYPE_NULL);
-         for (size_t i = 0; i < neighbourSendType.size(); ++i) {
-            if (other.neighbourSendType[i] != MPI_DATATYPE_NULL) {
-               MPI_Type_dup(other.neighbourSendType[i], neighbourSendType.data() + i);
-            }
-            if (other.neighbourReceiveType[i] != MPI_DATATYPE_NULL) {
-               MPI_Type_dup(other.neighbourReceiveType[i], neighbourReceiveType.data() + i);
-            }
+         if(comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&comm);
+            comm = MPI_COMM_NULL;
          }
       }
 
-      // Move constructor
-      // We don't have a default constructor, so just set the MPI stuff NULL
-      FsGrid(FsGrid&& other) noexcept : 
-         comm1d {MPI_COMM_NULL},
-         comm1d_aux {MPI_COMM_NULL},
-         comm3d {MPI_COMM_NULL},
-         comm3d_aux {MPI_COMM_NULL},
-         neighbourSendType {},
-         neighbourReceiveType {}
-      {
-         // NULL all the MPI stuff so they won't get freed if destroyed
-         neighbourSendType.fill(MPI_DATATYPE_NULL);
-         neighbourReceiveType.fill(MPI_DATATYPE_NULL);
+      ~FsGridTransferPlan() {
+         finalize();
+      }
+
+      FsGridTransferPlan(const FsGridTransferPlan&) = delete;
+      FsGridTransferPlan& operator=(const FsGridTransferPlan&) = delete;
 
-         using std::swap;
-         swap(*this, other);
-      }
+   private:
+      static const int transferTag = 9276;
 
-      // Copy assignment
-      // Canonical copy assign is construct to temp and swap, but this would result in an extra allocation of the entire grid
-      // Copy assignment is currently not used in Vlasiator, so the operator is deleted as any use is likely either erroneous or just a bad idea
-      FsGrid& operator=(FsGrid other) = delete;
+      MPI_Comm comm = MPI_COMM_NULL;
+      MPI_Datatype mpiTypeT = MPI_DATATYPE_NULL; //!< One cell, so that message counts are cells rather than bytes
+      int rank;
+      std::vector<BoxTransfer> sends;
+      std::vector<BoxTransfer> receives;
+      size_t sendBufferSize = 0;
+      size_t receiveBufferSize = 0;
+      std::vector<T> sendBuffer;
+      std::vector<T> receiveBuffer;
+      std::vector<MPI_Request> requests;
+};
 
-      // Move assignment
-      FsGrid& operator=(FsGrid&& other) noexcept {
-         using std::swap;
-         swap(*this, other);
-         return *this;
-      }
+/*! Reusable plan for averaging an FsGrid over blocks of factor^3 cells (factor^2 or factor
+ * for 2D and 1D grids) into a coarse grid, for example to write quick-look output with
+ * coarse.writeChunked(). The coarse grid has the fine grid's global size divided by factor
+ * (rounded up, with smaller blocks at the upper edges) in all non-collapsed dimensions,
+ * and any decomposition. Both grids have to be built from the same parent communicator.
+ *
+ * Every fine task sums its cells into the blocks it overlaps. Blocks cut by task boundaries
+ * are completed on the coarse side, where the partial sums of all overlapping fine tasks are
+ * added up, so execute() is a single exchange of coarse cells.
+ *
+ * \param T datastructure containing the field in each cell, a std::array, identical for both grids
+ */
+template <typename T> class FsGridCoarsening : public FsGridTools {
+   public:
 
-      /*! Returns the task responsible, and its localID for handling the cell with the given GlobalID
-       * \param id GlobalID of the cell for which task is to be determined
-       * \return a task for the grid's cartesian communicator
+      /*! Build the plan. This is collective over parent_comm.
+       * \param fine Grid to average
+       * \param coarse Grid to store the averages in
+       * \param factor Edge length of the averaged blocks, in fine cells
+       * \param parent_comm The communicator both grids were created from
        */
-      std::pair<int,LocalID> getTaskForGlobalID(GlobalID id) {
-         // Transform globalID to global cell coordinate
-         std::array<FsIndex_t, 3> cell = FsGridTools::globalIDtoCellCoord(id, globalSize);
-
-         // Find the index in the task grid this Cell belongs to
-         std::array<int, 3> taskIndex;
+      template<typename FineGrid, typename CoarseGrid>
+      FsGridCoarsening(FineGrid& fine, CoarseGrid& coarse, int factor, MPI_Comm parent_comm) {
+         fineSize = fine.getGlobalSize();
+         coarseSize = coarse.getGlobalSize();
          for(int i=0; i<3; i++) {
-            int n_per_task = globalSize[i] / ntasksPerDim[i];
-            int remainder = globalSize[i] % ntasksPerDim[i];
+            factors[i] = fineSize[i] > 1 ? factor : 1;
+            if(coarseSize[i] != (fineSize[i] + factors[i] - 1) / factors[i]) {
+               std::cerr << "FsGridCoarsening: coarse grid size " << coarseSize[i] << " doesn't fit fine grid size "
+                  << fineSize[i] << " and factor " << factor << " in dimension " << i << "." << std::endl;
+               throw std::runtime_error("FsGridCoarsening grid size mismatch");
+            }
+         }
+         MPI_Comm_dup(parent_comm, &comm);
+         MPI_Comm_rank(comm, &rank);
+         MPI_Type_contiguous(sizeof(T), MPI_BYTE, &mpiTypeT);
+         MPI_Type_commit(&mpiTypeT);
 
-            if(cell[i] < remainder * (n_per_task+1)) {
-               taskIndex[i] = cell[i] / (n_per_task + 1);
-            } else {
-               taskIndex[i] = remainder + (cell[i] - remainder*(n_per_task+1)) / n_per_task;
+         // The coarse cells our fine cells contribute to go to their coarse owners
+         if(fine.getRank() != -1) {
+            for(int i=0; i<3; i++) {
+               partialStart[i] = fine.getLocalStart()[i] / factors[i];
+               partialSize[i] = (fine.getLocalStart()[i] + fine.getLocalSize()[i] + factors[i] - 1) / factors[i] - partialStart[i];
             }
+            computeBoxTransfers(coarseSize, partialStart, partialSize, coarse.getDecomposition(), sends);
+            partial.resize((size_t)partialSize[0] * partialSize[1] * partialSize[2]);
+            workItems = std::max(1u, std::thread::hardware_concurrency());
+            rowBuffers.resize(workItems * fine.getLocalSize()[0]);
          }
 
-         // Get the task number from the communicator
-         std::pair<int,LocalID> retVal;
-         int status = MPI_Cart_rank(comm3d, taskIndex.data(), &retVal.first);
-         if(status != MPI_SUCCESS) {
-            std::cerr << "Unable to find FsGrid rank for global ID " << id << " (coordinates [";
+         // Our coarse cells get contributions from every fine task overlapping their blocks
+         if(coarse.getRank() != -1) {
+            const std::array<FsIndex_t, 3>& coarseStart = coarse.getLocalStart();
+            const std::array<FsIndex_t, 3>& coarseLocalSize = coarse.getLocalSize();
+            const std::array<Task_t, 3>& fineDecomposition = fine.getDecomposition();
+            std::array<Task_t, 3> firstTask, lastTask;
             for(int i=0; i<3; i++) {
-               std::cerr << cell[i] << ", ";
+               firstTask[i] = calcTaskIndex(fineSize[i], fineDecomposition[i], coarseStart[i] * factors[i]);
+               lastTask[i] = calcTaskIndex(fineSize[i], fineDecomposition[i],
+                     std::min<FsIndex_t>((coarseStart[i] + coarseLocalSize[i]) * factors[i], fineSize[i]) - 1);
             }
-            std::cerr << "]" << std::endl;
-            return std::pair<int,LocalID>(MPI_PROC_NULL,0);
+            size_t offset = 0;
+            std::array<Task_t, 3> task;
+            for(task[0] = firstTask[0]; task[0] <= lastTask[0]; task[0]++) {
+               for(task[1] = firstTask[1]; task[1] <= lastTask[1]; task[1]++) {
+                  for(task[2] = firstTask[2]; task[2] <= lastTask[2]; task[2]++) {
+                     BoxTransfer t;
+                     t.task = taskPositionToRank(task, fineDecomposition);
+                     t.count = 1;
+                     for(int i=0; i<3; i++) {
+                        const FsIndex_t fineStart = calcLocalStart(fineSize[i], fineDecomposition[i], task[i]);
+                        const FsIndex_t fineEnd = fineStart + calcLocalSize(fineSize[i], fineDecomposition[i], task[i]);
+                        const FsIndex_t start = std::max(coarseStart[i], fineStart / factors[i]);
+                        const FsIndex_t end = std::min(coarseStart[i] + coarseLocalSize[i], (fineEnd + factors[i] - 1) / factors[i]);
+                        t.localStart[i] = start - coarseStart[i];
+                        t.size[i] = end - start;
+                        t.count *= t.size[i];
+                     }
+                     t.offset = offset;
+                     offset += t.count;
+                     receives.push_back(t);
+                  }
+               }
+            }
+            receiveBuffer.resize(offset);
+            sums.resize((size_t)coarseLocalSize[0] * coarseLocalSize[1] * coarseLocalSize[2]);
          }
+         sendBuffer.resize(sends.empty() ? 0 : sends.back().offset + sends.back().count);
+         requests.reserve(sends.size() + receives.size());
+      }
 
-         // Determine localID of that cell within the target task
-         std::array<FsIndex_t, 3> thatTasksStart;
-         std::array<FsIndex_t, 3> thatTaskStorageSize;
-         for(int i=0; i<3; i++) {
-            thatTasksStart[i] = calcLocalStart(globalSize[i], ntasksPerDim[i], taskIndex[i]);
-            thatTaskStorageSize[i] = calcLocalSize(globalSize[i], ntasksPerDim[i], taskIndex[i]) + 2 * stencil;
+      /*! Average the interior cells of fine into the interior cells of coarse, and set the coarse
+       * grid's DX, DY, DZ and physicalGlobalStart to match. This is collective over the parent
+       * communicator. Ghost cells of coarse are not updated.
+       * \param executor Parallel backend of the local averaging
+       */
+      template<typename FineGrid, typename CoarseGrid, typename Executor = FsGridOpenMP>
+      void execute(FineGrid& fine, CoarseGrid& coarse, Executor&& executor = Executor()) {
+         const int components = FsGridCellTraits<T>::components;
+         requests.clear();
+         for(const BoxTransfer& r : receives) {
+            if(r.task != rank) {
+               requests.push_back(MPI_REQUEST_NULL);
+               MPI_Irecv(receiveBuffer.data() + r.offset, r.count, mpiTypeT, r.task, coarseningTag, comm, &requests.back());
+            }
          }
 
-         retVal.second = 0;
-         int stride = 1;
-         for(int i=0; i<3; i++) {
-            if(globalSize[i] <= 1) {
-               // Collapsed dimension, doesn't contribute.
-               retVal.second += 0;
-            } else {
-               retVal.second += stride*(cell[i] - thatTasksStart[i] + stencil);
-               stride *= thatTaskStorageSize[i];
+         if(fine.getRank() != -1) {
+            // Sum up our part of each block. The rows of coarse cells are split into workItems
+            // contiguous ranges, each with its own buffer for the fine rows.
+            const std::array<FsIndex_t, 3> fineStart = fine.getLocalStart();
+            const std::array<FsIndex_t, 3> fineLocalSize = fine.getLocalSize();
+            const size_t coarseRows = (size_t)partialSize[1] * partialSize[2];
+            executor.parallelFor(workItems, [&](size_t item) {
+               T* row = rowBuffers.data() + item * fineLocalSize[0];
+               const size_t lastRow = coarseRows * (item + 1) / workItems;
+               for(size_t coarseRow = coarseRows * item / workItems; coarseRow < lastRow; coarseRow++) {
+                  const FsIndex_t cy = coarseRow % partialSize[1];
+                  const FsIndex_t cz = coarseRow / partialSize[1];
+                  T* sum = partial.data() + coarseRow * partialSize[0];
+                  std::fill(sum, sum + partialSize[0], T());
+                  std::array<FsIndex_t, 3> lower, upper;
+                  for(int i : {1, 2}) {
+                     const FsIndex_t c = partialStart[i] + (i == 1 ? cy : cz);
+                     lower[i] = std::max<FsIndex_t>(c * factors[i], fineStart[i]) - fineStart[i];
+                     upper[i] = std::min<FsIndex_t>((c + 1) * factors[i], fineStart[i] + fineLocalSize[i]) - fineStart[i];
+                  }
+                  for(FsIndex_t z = lower[2]; z < upper[2]; z++) {
+                     for(FsIndex_t y = lower[1]; y < upper[1]; y++) {
+                        fine.packBox({0, y, z}, {fineLocalSize[0], 1, 1}, row);
+                        for(FsIndex_t x = 0; x < fineLocalSize[0]; x++) {
+                           T& s = sum[(fineStart[0] + x) / factors[0] - partialStart[0]];
+                           for(int c=0; c<components; c++) {
+                              s[c] += row[x][c];
+                           }
+                        }
+                     }
+                  }
+               }
+            });
+
+            for(const BoxTransfer& s : sends) {
+               packPartial(s, sendBuffer.data() + s.offset);
+               if(s.task != rank) {
+                  requests.push_back(MPI_REQUEST_NULL);
+                  MPI_Isend(sendBuffer.data() + s.offset, s.count, mpiTypeT, s.task, coarseningTag, comm, &requests.back());
+               }
             }
          }
-         
-         return retVal;
-      }
 
-      /*! Transform global cell coordinates into the local domain.
-       * If the coordinates are out of bounds, (-1,-1,-1) is returned.
-       * \param x The cell's global x coordinate
-       * \param y The cell's global y coordinate
-       * \param z The cell's global z coordinate
-       */
-      std::array<FsIndex_t, 3> globalToLocal(FsSize_t x, FsSize_t y, FsSize_t z) {
-         std::array<FsIndex_t, 3> retval;
-         retval[0] = (FsIndex_t)x - localStart[0];
-         retval[1] = (FsIndex_t)y - localStart[1];
-         retval[2] = (FsIndex_t)z - localStart[2];
+         // Our own partial sums
+         copyOwnTransfers(sends, receives, rank, sendBuffer.data(), receiveBuffer.data());
 
-         if(retval[0] >= localSize[0] || retval[1] >= localSize[1] || retval[2] >= localSize[2]
-               || retval[0] < 0 || retval[1] < 0 || retval[2] < 0) {
-            return {-1,-1,-1};
+         MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+         if(coarse.getRank() != -1) {
+            const std::array<FsIndex_t, 3> coarseStart = coarse.getLocalStart();
+            const std::array<FsIndex_t, 3> coarseLocalSize = coarse.getLocalSize();
+            std::fill(sums.begin(), sums.end(), T());
+            for(const BoxTransfer& r : receives) {
+               const T* from = receiveBuffer.data() + r.offset;
+               for(FsIndex_t z = 0; z < r.size[2]; z++) {
+                  for(FsIndex_t y = 0; y < r.size[1]; y++) {
+                     T* to = sums.data() + ((size_t)(r.localStart[2] + z) * coarseLocalSize[1] + r.localStart[1] + y) * coarseLocalSize[0]
+                        + r.localStart[0];
+                     for(FsIndex_t x = 0; x < r.size[0]; x++, from++) {
+                        for(int c=0; c<components; c++) {
+                           to[x][c] += (*from)[c];
+                        }
+                     }
+                  }
+               }
+            }
+            // Blocks at the upper edges of the domain can have fewer cells
+            executor.parallelFor((size_t)coarseLocalSize[1] * coarseLocalSize[2], [&](size_t coarseRow) {
+               const FsIndex_t y = coarseRow % coarseLocalSize[1];
+               const FsIndex_t z = coarseRow / coarseLocalSize[1];
+               const double rowCells = (double)blockCells(1, coarseStart[1] + y) * blockCells(2, coarseStart[2] + z);
+               T* row = sums.data() + coarseRow * coarseLocalSize[0];
+               for(FsIndex_t x = 0; x < coarseLocalSize[0]; x++) {
+                  const double cells = rowCells * blockCells(0, coarseStart[0] + x);
+                  for(int c=0; c<components; c++) {
+                     row[x][c] /= cells;
+                  }
+               }
+               coarse.unpackBox({0, y, z}, {coarseLocalSize[0], 1, 1}, row);
+            });
          }
 
-         return retval;
+         coarse.DX = fine.DX * factors[0];
+         coarse.DY = fine.DY * factors[1];
+         coarse.DZ = fine.DZ * factors[2];
+         coarse.physicalGlobalStart = fine.physicalGlobalStart;
       }
 
-      /*! Determine the cell's GlobalID from its local x,y,z coordinates
-       * \param x The cell's task-local x coordinate
-       * \param y The cell's task-local y coordinate
-       * \param z The cell's task-local z coordinate
-       */
-      GlobalID GlobalIDForCoords(int x, int y, int z) {
-         return x + localStart[0] + globalSize[0] * (y + localStart[1]) + globalSize[0] * globalSize[1] * (z + localStart[2]);
-      }
-      /*! Determine the cell's LocalID from its local x,y,z coordinates
-       * \param x The cell's task-local x coordinate
-       * \param y The cell's task-local y coordinate
-       * \param z The cell's task-local z coordinate
+      /*!
+       *  MPI calls fail after the main program called MPI_Finalize(),
+       *  so this can be used instead of the destructor
        */
-      LocalID LocalIDForCoords(int x, int y, int z) {
-         LocalID index=0;
-         if(globalSize[2] > 1) {
-            index += storageSize[0]*storageSize[1]*(stencil+z);
-         }
-         if(globalSize[1] > 1) {
-            index += storageSize[0]*(stencil+y);
+      void finalize() noexcept {
+         if(mpiTypeT != MPI_DATATYPE_NULL) {
+            MPI_Type_free(&mpiTypeT);
+            mpiTypeT = MPI_DATATYPE_NULL;
          }
-         if(globalSize[0] > 1 ) {
-            index += stencil+x;
+         if(comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&comm);
+            comm = MPI_COMM_NULL;
          }
+      }
 
-         return index;
+      ~FsGridCoarsening() {
+         finalize();
       }
 
-      /*! Perform ghost cell communication.
-       */
-      void updateGhostCells() {
+      FsGridCoarsening(const FsGridCoarsening&) = delete;
+      FsGridCoarsening& operator=(const FsGridCoarsening&) = delete;
 
-         if(rank == -1) return;
+   private:
+      //! Number of fine cells of coarse cell c in dimension i
+      FsIndex_t blockCells(int i, FsIndex_t c) const {
+         return std::min<FsIndex_t>(factors[i], fineSize[i] - c * factors[i]);
+      }
 
-         //TODO, faster with simultaneous isends& ireceives?
-         std::array<MPI_Request, 27> receiveRequests;
-         std::array<MPI_Request, 27> sendRequests;
-         
-         for(int i = 0; i < 27; i++){
-            receiveRequests[i] = MPI_REQUEST_NULL;
-            sendRequests[i] = MPI_REQUEST_NULL;
-         }
-         
-         
-         for(int x=-1; x<=1;x++) {
-            for(int y=-1; y<=1;y++) {
-               for(int z=-1; z<=1; z++) {
-                  int shiftId = (x+1) * 9 + (y + 1) * 3 + (z + 1);
-                  int receiveId = (1 - x) * 9 + ( 1 - y) * 3 + ( 1 - z);
-                  if(neighbour[receiveId] != MPI_PROC_NULL &&
-                     neighbourSendType[shiftId] != MPI_DATATYPE_NULL) {
-                     MPI_Irecv(data.data(), 1, neighbourReceiveType[shiftId], neighbour[receiveId], shiftId, comm3d, &(receiveRequests[shiftId]));
-                  }
-               }
+      //! Copy the box of a send transfer out of the partial sums
+      void packPartial(const BoxTransfer& s, T* buffer) const {
+         for(FsIndex_t z = 0; z < s.size[2]; z++) {
+            for(FsIndex_t y = 0; y < s.size[1]; y++) {
+               const T* row = partial.data() + ((size_t)(s.localStart[2] + z) * partialSize[1] + s.localStart[1] + y) * partialSize[0]
+                  + s.localStart[0];
+               buffer = std::copy(row, row + s.size[0], buffer);
             }
          }
-         
-         for(int x=-1; x<=1;x++) {
-            for(int y=-1; y<=1;y++) {
-               for(int z=-1; z<=1; z++) {
-                  int shiftId = (x+1) * 9 + (y + 1) * 3 + (z + 1);
-                  int sendId = shiftId;
-                  if(neighbour[sendId] != MPI_PROC_NULL &&
-                     neighbourSendType[shiftId] != MPI_DATATYPE_NULL) {
-                     MPI_Isend(data.data(), 1, neighbourSendType[shiftId], neighbour[sendId], shiftId, comm3d, &(sendRequests[shiftId]));
-                  }
-               }
-            }
+      }
+
+      static const int coarseningTag = 9277;
+
+      MPI_Comm comm = MPI_COMM_NULL;
+      MPI_Datatype mpiTypeT = MPI_DATATYPE_NULL; //!< One cell, so that message counts are cells rather than bytes
+      int rank;
+      std::array<FsIndex_t, 3> factors; //!< Block size in each dimension, 1 for collapsed ones
+      std::array<FsSize_t, 3> fineSize;
+      std::array<FsSize_t, 3> coarseSize;
+
+      // Fine side: partial sums of the coarse cells our cells overlap
+      std::array<FsIndex_t, 3> partialStart = {0, 0, 0}; //!< Global coarse coordinates of the first partial sum
+      std::array<FsIndex_t, 3> partialSize = {0, 0, 0};
+      std::vector<T> partial;
+      size_t workItems = 0; //!< Number of ranges the partial sums are computed in, one per hardware thread
+      std::vector<T> rowBuffers; //!< One row of fine cells for each work item
+      std::vector<BoxTransfer> sends; //!< Boxes relative to partialStart
+      std::vector<T> sendBuffer;
+
+      // Coarse side: contributions of all fine tasks overlapping our coarse cells
+      std::vector<BoxTransfer> receives; //!< Boxes relative to the coarse grid's local start
+      std::vector<T> receiveBuffer;
+      std::vector<T> sums;
+      std::vector<MPI_Request> requests;
+};
+
+/*! Reusable communication plan for copying cell data between an FsGrid and the
+ * host code's own (differently distributed) cells.
+ *
+ * The host hands in the GlobalIDs of the cells it holds on this task, together with
+ * either pointers to their data or indices into a host array. The owning FsGrid tasks
+ * and LocalIDs are determined once, the cells are sorted by owner, and the owners learn
+ * which of their cells to expect. copyIn() and copyOut() are then a single
+ * MPI_Alltoallv each.
+ *
+ * \param T datastructure containing the field in each cell, identical to the grid's
+ */
+template <typename T> class FsGridCoupling : public FsGridTools {
+   public:
+
+      /*! Build the plan for host cells given by pointers. This is collective over parent_comm.
+       * \param grid The grid to couple to
+       * \param parent_comm The communicator the grid was created from
+       * \param cells GlobalID and data pointer of each host cell on this task
+       */
+      template<typename Grid>
+      FsGridCoupling(Grid& grid, MPI_Comm parent_comm, const std::vector<std::pair<GlobalID, T*>>& cells) {
+         std::vector<GlobalID> ids(cells.size());
+         for(size_t i=0; i<cells.size(); i++) {
+            ids[i] = cells[i].first;
+         }
+         std::vector<size_t> order = setup(grid, parent_comm, ids);
+         hostCells.resize(order.size());
+         for(size_t i=0; i<order.size(); i++) {
+            hostCells[i] = cells[order[i]].second;
          }
-         MPI_Waitall(27, receiveRequests.data(), MPI_STATUSES_IGNORE);         
-         MPI_Waitall(27, sendRequests.data(), MPI_STATUSES_IGNORE);
       }
-   
-      /*! Get the size of the local domain handled by this grid.
+
+      /*! Build the plan for host cells given by indices into a host array. This is collective over parent_comm.
+       * \param grid The grid to couple to
+       * \param parent_comm The communicator the grid was created from
+       * \param cells GlobalID and host array index of each host cell on this task
        */
-      std::array<FsIndex_t, 3>& getLocalSize() {
-         return localSize;
+      template<typename Grid>
+      FsGridCoupling(Grid& grid, MPI_Comm parent_comm, const std::vector<std::pair<GlobalID, size_t>>& cells) {
+         std::vector<GlobalID> ids(cells.size());
+         for(size_t i=0; i<cells.size(); i++) {
+            ids[i] = cells[i].first;
+         }
+         std::vector<size_t> order = setup(grid, parent_comm, ids);
+         hostIndices.resize(order.size());
+         for(size_t i=0; i<order.size(); i++) {
+            hostIndices[i] = cells[order[i]].second;
+         }
       }
 
-      /*! Get the start coordinates of the local domain handled by this grid.
+      /*! Copy the host cells into the grid (plan built from pointers). Collective. */
+      template<typename Grid> void copyIn(Grid& grid) {
+         assert(hostIndices.empty());
+         for(size_t i=0; i<hostCells.size(); i++) {
+            hostBuffer[i] = *hostCells[i];
+         }
+         exchangeIn(grid);
+      }
+
+      /*! Copy the host cells into the grid (plan built from indices). Collective.
+       * \param hostData Host array the indices refer to
        */
-      std::array<FsIndex_t, 3>& getLocalStart() {
-         return localStart;
+      template<typename Grid> void copyIn(Grid& grid, const T* hostData) {
+         assert(hostCells.empty());
+         for(size_t i=0; i<hostIndices.size(); i++) {
+            hostBuffer[i] = hostData[hostIndices[i]];
+         }
+         exchangeIn(grid);
       }
 
-      /*! Get global size of the fsgrid domain
+      /*! Copy the grid's cells back out to the host cells (plan built from pointers). Collective. */
+      template<typename Grid> void copyOut(Grid& grid) {
+         assert(hostIndices.empty());
+         exchangeOut(grid);
+         for(size_t i=0; i<hostCells.size(); i++) {
+            *hostCells[i] = hostBuffer[i];
+         }
+      }
+
+      /*! Copy the grid's cells back out to the host array (plan built from indices). Collective.
+       * \param hostData Host array the indices refer to
        */
-      std::array<FsSize_t, 3>& getGlobalSize() {
-         return globalSize;
+      template<typename Grid> void copyOut(Grid& grid, T* hostData) {
+         assert(hostCells.empty());
+         exchangeOut(grid);
+         for(size_t i=0; i<hostIndices.size(); i++) {
+            hostData[hostIndices[i]] = hostBuffer[i];
+         }
       }
 
-      /*! Calculate global cell position (XYZ in global cell space) from local cell coordinates.
-       *
-       * \param x x-Coordinate, in cells
-       * \param y y-Coordinate, in cells
-       * \param z z-Coordinate, in cells
-       *
-       * \return Global cell coordinates
+      /*!
+       *  MPI calls fail after the main program called MPI_Finalize(),
+       *  so this can be used instead of the destructor
        */
-      std::array<FsIndex_t, 3> getGlobalIndices(int64_t x, int64_t y, int64_t z) {
-         std::array<FsIndex_t, 3> retval;
-         retval[0] = localStart[0] + x;
-         retval[1] = localStart[1] + y;
-         retval[2] = localStart[2] + z;
+      void finalize() noexcept {
+         if(comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&comm);
+            comm = MPI_COMM_NULL;
+         }
+         if(mpiTypeT != MPI_DATATYPE_NULL) {
+            MPI_Type_free(&mpiTypeT);
+            mpiTypeT = MPI_DATATYPE_NULL;
+         }
+      }
 
-         return retval;
+      ~FsGridCoupling() {
+         finalize();
       }
 
-      /*! Get a reference to the field data in a cell
-       * \param x x-Coordinate, in cells
-       * \param y y-Coordinate, in cells
-       * \param z z-Coordinate, in cells
-       * \return A reference to cell data in the given cell
+      FsGridCoupling(const FsGridCoupling&) = delete;
+      FsGridCoupling& operator=(const FsGridCoupling&) = delete;
+
+   private:
+
+      /*! Find the owners of all host cells, and tell each owner which of its cells we hold.
+       * \return Order in which the host cells are sent (sorted by owner task and LocalID)
        */
-      T* get(int x, int y, int z) {
+      template<typename Grid>
+      std::vector<size_t> setup(Grid& grid, MPI_Comm parent_comm, const std::vector<GlobalID>& ids) {
+         MPI_Comm_dup(parent_comm, &comm);
+         int commSize;
+         MPI_Comm_size(comm, &commSize);
+         MPI_Type_contiguous(sizeof(T), MPI_BYTE, &mpiTypeT);
+         MPI_Type_commit(&mpiTypeT);
 
-         // Keep track which neighbour this cell actually belongs to (13 = ourself)
-         int isInNeighbourDomain=13;
-         int coord_shift[3] = {0,0,0};
-         if(x < 0) {
-            isInNeighbourDomain -= 9;
-            coord_shift[0] = 1;
+         std::vector<Task_t> tasks(ids.size());
+         std::vector<LocalID> localIDs(ids.size());
+         grid.getTasksForGlobalIDs(ids.size(), ids.data(), tasks.data(), localIDs.data());
+         std::vector<std::pair<Task_t,LocalID>> owners(ids.size());
+         for(size_t i=0; i<ids.size(); i++) {
+            owners[i] = std::make_pair(tasks[i], localIDs[i]);
          }
-         if(x >= localSize[0]) {
-            isInNeighbourDomain += 9;
-            coord_shift[0] = -1;
+
+         std::vector<size_t> order(ids.size());
+         for(size_t i=0; i<order.size(); i++) {
+            order[i] = i;
          }
-         if(y < 0) {
-            isInNeighbourDomain -= 3;
-            coord_shift[1] = 1;
+         std::sort(order.begin(), order.end(), [&owners](size_t a, size_t b) -> bool {
+            return owners[a] < owners[b];
+         });
+
+         hostCounts.assign(commSize, 0);
+         std::vector<LocalID> hostLocalIDs(ids.size());
+         for(size_t i=0; i<order.size(); i++) {
+            hostCounts[owners[order[i]].first]++;
+            hostLocalIDs[i] = owners[order[i]].second;
          }
-         if(y >= localSize[1]) {
-            isInNeighbourDomain += 3;
-            coord_shift[1] = -1;
+
+         gridCounts.resize(commSize);
+         MPI_Alltoall(hostCounts.data(), 1, MPI_INT, gridCounts.data(), 1, MPI_INT, comm);
+         hostDisplacements = displacements(hostCounts);
+         gridDisplacements = displacements(gridCounts);
+
+         gridLocalIDs.resize(gridDisplacements.back() + gridCounts.back());
+         MPI_Alltoallv(hostLocalIDs.data(), hostCounts.data(), hostDisplacements.data(), MPI_INT64_T,
+               gridLocalIDs.data(), gridCounts.data(), gridDisplacements.data(), MPI_INT64_T, comm);
+
+         hostBuffer.resize(ids.size());
+         gridBuffer.resize(gridLocalIDs.size());
+         return order;
+      }
+
+      template<typename Grid> void exchangeIn(Grid& grid) {
+         MPI_Alltoallv(hostBuffer.data(), hostCounts.data(), hostDisplacements.data(), mpiTypeT,
+               gridBuffer.data(), gridCounts.data(), gridDisplacements.data(), mpiTypeT, comm);
+         for(size_t i=0; i<gridLocalIDs.size(); i++) {
+            *grid.get(gridLocalIDs[i]) = gridBuffer[i];
          }
-         if(z < 0) {
-            isInNeighbourDomain -= 1;
-            coord_shift[2] = 1;
+      }
+
+      template<typename Grid> void exchangeOut(Grid& grid) {
+         for(size_t i=0; i<gridLocalIDs.size(); i++) {
+            gridBuffer[i] = *grid.get(gridLocalIDs[i]);
          }
-         if(z >= localSize[2]) {
-            isInNeighbourDomain += 1;
-            coord_shift[2] = -1;
+         MPI_Alltoallv(gridBuffer.data(), gridCounts.data(), gridDisplacements.data(), mpiTypeT,
+               hostBuffer.data(), hostCounts.data(), hostDisplacements.data(), mpiTypeT, comm);
+      }
+
+      MPI_Comm comm = MPI_COMM_NULL;
+      MPI_Datatype mpiTypeT = MPI_DATATYPE_NULL;
+
+      // Host side: our cells, sorted by owning task and LocalID
+      std::vector<T*> hostCells;
+      std::vector<size_t> hostIndices;
+      std::vector<int> hostCounts;
+      std::vector<int> hostDisplacements;
+      std::vector<T> hostBuffer;
+
+      // Grid side: the LocalIDs other tasks hold copies of, in rank order
+      std::vector<LocalID> gridLocalIDs;
+      std::vector<int> gridCounts;
+      std::vector<int> gridDisplacements;
+      std::vector<T> gridBuffer;
+};
+
+/*! Reusable plan for sampling an FsGrid at a set of physical positions, e.g. of spacecraft or
+ * virtual probes, which every task may hold any number of.
+ *
+ * Cell values are taken to sit at cell centres, half a cell above getPhysicalCoords(), and are
+ * interpolated trilinearly. Each probe is routed once to the task owning the lower corner of its
+ * interpolation stencil, which reads the upper corner from its ghost cells; sample() then needs
+ * a single MPI_Alltoallv to return the interpolated values of all probes to their requesters.
+ * Periodic dimensions wrap around. In non-periodic ones, positions within half a cell of the
+ * boundary take the boundary cell's value, and positions outside the domain sample NaN. The plan
+ * uses the grid's DX, DY, DZ and physicalGlobalStart at construction.
+ *
+ * \param T datastructure containing the field in each cell, a std::array, identical to the grid's
+ */
+template <typename T> class FsGridProbes : public FsGridTools {
+   public:
+
+      /*! Build the plan. This is collective over parent_comm.
+       * \param grid The grid to sample, with a stencil of at least one cell
+       * \param parent_comm The communicator the grid was created from
+       * \param positions Physical coordinates of this task's probes
+       */
+      template<typename Grid>
+      FsGridProbes(Grid& grid, MPI_Comm parent_comm, const std::vector<std::array<double, 3>>& positions) {
+         const std::array<FsSize_t, 3>& globalSize = grid.getGlobalSize();
+         const std::array<bool, 3>& periodic = grid.getPeriodic();
+         const std::array<double, 3> spacing = {grid.DX, grid.DY, grid.DZ};
+         for(int i=0; i<3; i++) {
+            if(globalSize[i] > 1 && grid.getTopology()->getStencil() < 1) {
+               std::cerr << "FsGridProbes: interpolation needs a grid with ghost cells." << std::endl;
+               throw std::runtime_error("FsGridProbes without ghost cells");
+            }
+         }
+         MPI_Comm_dup(parent_comm, &comm);
+         int commSize;
+         MPI_Comm_size(comm, &commSize);
+         MPI_Type_contiguous(sizeof(Probe), MPI_BYTE, &mpiTypeProbe);
+         MPI_Type_commit(&mpiTypeProbe);
+
+         // Interpolation stencil of each probe, given by its lower corner cell
+         std::vector<Probe> probes(positions.size());
+         std::vector<FsIndex_t> corner[3];
+         for(int i=0; i<3; i++) {
+            corner[i].resize(positions.size());
+         }
+         inside.assign(positions.size(), true);
+         for(size_t p=0; p<positions.size(); p++) {
+            probes[p].upper = 0;
+            for(int i=0; i<3; i++) {
+               FsIndex_t lower = 0;
+               double weight = 0;
+               if(globalSize[i] > 1) {
+                  double x = (positions[p][i] - grid.physicalGlobalStart[i]) / spacing[i];
+                  if(periodic[i]) {
+                     x = std::fmod(x, (double)globalSize[i]);
+                     x += x < 0 ? globalSize[i] : 0;
+                  } else if(!(x >= 0 && x <= globalSize[i])) {
+                     inside[p] = false;
+                  }
+                  // Cell centres are at x = n + 1/2
+                  const double u = x - 0.5;
+                  lower = (FsIndex_t)std::floor(u);
+                  weight = u - lower;
+                  if(lower < 0) {
+                     if(periodic[i]) {
+                        lower += globalSize[i];
+                     } else {
+                        lower = 0;
+                        weight = 0;
+                     }
+                  } else if(lower >= (FsIndex_t)globalSize[i] - 1 && !periodic[i]) {
+                     lower = globalSize[i] - 1;
+                     weight = 0;
+                  }
+                  if(!inside[p]) {
+                     lower = 0;
+                     weight = 0;
+                  }
+               }
+               corner[i][p] = lower;
+               probes[p].cell[i] = lower;
+               probes[p].weight[i] = weight;
+               // Skip the upper neighbour when it doesn't contribute, it may not exist
+               probes[p].upper |= (weight > 0) << i;
+            }
          }
+         std::vector<Task_t> tasks(positions.size());
+         std::vector<LocalID> localIDs(positions.size());
+         grid.getTasksForGlobalCoords(positions.size(), corner[0].data(), corner[1].data(), corner[2].data(), tasks.data(), localIDs.data());
 
-         // Santiy-Check that the requested cell is actually inside our domain
-         // TODO: ugh, this is ugly.
-#ifdef FSGRID_DEBUG
-         bool inside=true;
-         if(localSize[0] <= 1 && !periodic[0]) {
-            if(x != 0) {
-               std::cerr << "x != 0 despite non-periodic x-axis with only one cell." << std::endl;
-               inside = false;
-            }
-         } else {
-            if(x < -stencil || x >= localSize[0] + stencil) {
-               std::cerr << "x = " << x << " is outside of [ " << -stencil << 
-                  ", " << localSize[0] + stencil << "[!" << std::endl;
-               inside = false;
+         // Probes outside the domain aren't sent anywhere
+         order.clear();
+         for(size_t p=0; p<positions.size(); p++) {
+            if(inside[p]) {
+               order.push_back(p);
             }
          }
+         std::stable_sort(order.begin(), order.end(), [&tasks](size_t a, size_t b) -> bool {
+            return tasks[a] < tasks[b];
+         });
+         hostCounts.assign(commSize, 0);
+         std::vector<Probe> sortedProbes(order.size());
+         for(size_t i=0; i<order.size(); i++) {
+            hostCounts[tasks[order[i]]]++;
+            sortedProbes[i] = probes[order[i]];
+         }
 
-         if(localSize[1] <= 1 && !periodic[1]) {
-            if(y != 0) {
-               std::cerr << "y != 0 despite non-periodic y-axis with only one cell." << std::endl;
-               inside = false;
-            }
-         } else {
-            if(y < -stencil || y >= localSize[1] + stencil) {
-               std::cerr << "y = " << y << " is outside of [ " << -stencil <<
-                  ", " << localSize[1] + stencil << "[!" << std::endl;
-               inside = false;
+         gridCounts.resize(commSize);
+         MPI_Alltoall(hostCounts.data(), 1, MPI_INT, gridCounts.data(), 1, MPI_INT, comm);
+         hostDisplacements = displacements(hostCounts);
+         gridDisplacements = displacements(gridCounts);
+         gridProbes.resize(gridDisplacements.back() + gridCounts.back());
+         MPI_Alltoallv(sortedProbes.data(), hostCounts.data(), hostDisplacements.data(), mpiTypeProbe,
+               gridProbes.data(), gridCounts.data(), gridDisplacements.data(), mpiTypeProbe, comm);
+
+         // Owners keep their probes' stencils in local coordinates
+         const std::array<FsIndex_t, 3>& localStart = grid.getLocalStart();
+         for(Probe& probe : gridProbes) {
+            for(int i=0; i<3; i++) {
+               probe.cell[i] -= localStart[i];
             }
          }
+      }
 
-         if(localSize[2] <= 1 && !periodic[2]) {
-            if(z != 0) {
-               std::cerr << "z != 0 despite non-periodic z-axis with only one cell." << std::endl;
-               inside = false;
+      /*! Interpolate components of the grid at all probes. The grid's ghost cells have to be up to date.
+       * Collective over the plan's communicator.
+       * \param grid The grid the plan was built for, or one of the same decomposition and geometry
+       * \param firstComponent First component to sample
+       * \param numComponents Number of consecutive components to sample
+       * \param results Output: numComponents values for each of this task's probes, in the order they were given
+       * \param executor Parallel backend of the interpolation
+       */
+      template<typename Grid, typename Real, typename Executor = FsGridOpenMP>
+      void sample(Grid& grid, int firstComponent, int numComponents, Real* results, Executor&& executor = Executor()) {
+         static_assert(std::is_same<Real, typename FsGridCellTraits<T>::value_type>::value,
+               "FsGridProbes::sample() needs buffers of the cells' value type");
+         if(firstComponent < 0 || numComponents <= 0 || firstComponent + numComponents > FsGridCellTraits<T>::components) {
+            std::cerr << "FsGridProbes: components " << firstComponent << " to " << firstComponent + numComponents
+               << " requested from cells of " << FsGridCellTraits<T>::components << " components." << std::endl;
+            throw std::runtime_error("FsGridProbes component mismatch");
+         }
+         gridBuffer.resize(gridProbes.size() * numComponents);
+         hostBuffer.resize(order.size() * numComponents);
+
+         executor.parallelFor(gridProbes.size(), [&](size_t p) {
+            const Probe& probe = gridProbes[p];
+            Real* value = gridBuffer.data() + p * numComponents;
+            std::fill(value, value + numComponents, Real(0));
+            for(int corner=0; corner<8; corner++) {
+               if(corner & ~probe.upper) {
+                  continue;
+               }
+               double weight = 1;
+               for(int i=0; i<3; i++) {
+                  weight *= (corner >> i & 1) ? probe.weight[i] : 1 - probe.weight[i];
+               }
+               const auto cell = grid.get(probe.cell[0] + (corner & 1), probe.cell[1] + (corner >> 1 & 1), probe.cell[2] + (corner >> 2 & 1));
+               for(int c=0; c<numComponents; c++) {
+                  value[c] += weight * (*cell)[firstComponent + c];
+               }
             }
-         } else {
-            if(z < -stencil || z >= localSize[2] + stencil) {
-               inside = false;
-               std::cerr << "z = " << z << " is outside of [ " << -stencil <<
-                  ", " << localSize[2] + stencil << "[!" << std::endl;
+         });
+
+         MPI_Datatype valuesType;
+         MPI_Type_contiguous(numComponents * sizeof(Real), MPI_BYTE, &valuesType);
+         MPI_Type_commit(&valuesType);
+         MPI_Alltoallv(gridBuffer.data(), gridCounts.data(), gridDisplacements.data(), valuesType,
+               hostBuffer.data(), hostCounts.data(), hostDisplacements.data(), valuesType, comm);
+         MPI_Type_free(&valuesType);
+
+         for(size_t p=0; p<inside.size(); p++) {
+            if(!inside[p]) {
+               std::fill(results + p * numComponents, results + (p + 1) * numComponents, std::numeric_limits<Real>::quiet_NaN());
             }
          }
-         if(!inside) {
-            std::cerr << "Out-of bounds access in FsGrid::get! Expect weirdness." << std::endl;
-            return NULL;
+         for(size_t i=0; i<order.size(); i++) {
+            std::copy(hostBuffer.data() + i * numComponents, hostBuffer.data() + (i + 1) * numComponents, results + order[i] * numComponents);
          }
-#endif // FSGRID_DEBUG
+      }
 
-         if(isInNeighbourDomain != 13) {
+      //! Number of this task's probes
+      size_t getNumProbes() const {
+         return inside.size();
+      }
 
-            // Check if the corresponding neighbour exists
-            if(neighbour[isInNeighbourDomain]==MPI_PROC_NULL) {
-               // Neighbour doesn't exist, we must be an outer boundary cell
-               // (or something is quite wrong)
-               return NULL;
+      /*!
+       *  MPI calls fail after the main program called MPI_Finalize(),
+       *  so this can be used instead of the destructor
+       */
+      void finalize() noexcept {
+         if(comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&comm);
+            comm = MPI_COMM_NULL;
+         }
+         if(mpiTypeProbe != MPI_DATATYPE_NULL) {
+            MPI_Type_free(&mpiTypeProbe);
+            mpiTypeProbe = MPI_DATATYPE_NULL;
+         }
+      }
 
-            } else if(neighbour[isInNeighbourDomain] == rank) {
-               // For periodic boundaries, where the neighbour is actually ourself,
-               // return our own actual cell instead of the ghost
-               x += coord_shift[0] * localSize[0];
-               y += coord_shift[1] * localSize[1];
-               z += coord_shift[2] * localSize[2];
-            }
-            // Otherwise we return the ghost cell
+      ~FsGridProbes() {
+         finalize();
+      }
+
+      FsGridProbes(const FsGridProbes&) = delete;
+      FsGridProbes& operator=(const FsGridProbes&) = delete;
+
+   private:
+      //! Interpolation stencil of a probe, as sent to its owner
+      struct Probe {
+         std::array<FsIndex_t, 3> cell; //!< Lower corner cell, in global (on the requester) or local (on the owner) coordinates
+         int32_t upper; //!< Bit i is set if the upper neighbour in dimension i contributes
+         std::array<double, 3> weight; //!< Weight of the upper neighbour in each dimension
+      };
+
+      MPI_Comm comm = MPI_COMM_NULL;
+      MPI_Datatype mpiTypeProbe = MPI_DATATYPE_NULL;
+
+      // Requester side: our probes, sorted by owning task
+      std::vector<bool> inside; //!< Whether each probe lies within the domain
+      std::vector<size_t> order; //!< Probes inside the domain, in the order they are exchanged
+      std::vector<int> hostCounts;
+      std::vector<int> hostDisplacements;
+
+      // Owner side: the probes other tasks sample from our cells, in rank order
+      std::vector<Probe> gridProbes;
+      std::vector<int> gridCounts;
+      std::vector<int> gridDisplacements;
+
+      std::vector<typename FsGridCellTraits<T>::value_type> hostBuffer;
+      std::vector<typename FsGridCellTraits<T>::value_type> gridBuffer;
+};
+
+/*! Checkpoint writer which doesn't stall the simulation while the file system works.
+ * start() snapshots the interior cells of a grid into a staging buffer, which is a fast
+ * parallel copy, and returns; a background thread then writes the snapshot into a file
+ * of the same format as FsGrid::writeCheckpoint(), with collective MPI-IO on a private
+ * duplicate of the grid's communicator. The grid can be modified as soon as start() returns.
+ *
+ * The background thread needs MPI_THREAD_MULTIPLE. With a lower thread level, start()
+ * writes the file itself before returning.
+ *
+ * \param T datastructure containing the field in each cell, identical to the grid's
+ */
+template <typename T> class FsGridAsyncCheckpoint : public FsGridTools {
+   public:
+
+      /*! Set up the staging buffer for a grid. This is collective over the grid's tasks.
+       * \param grid The grid to checkpoint, or any other one of the same decomposition
+       */
+      template<typename Grid> explicit FsGridAsyncCheckpoint(Grid& grid) {
+         if(grid.getRank() == -1) {
+            return;
          }
-         LocalID index = LocalIDForCoords(x,y,z);
+         MPI_Comm_dup(grid.getTopology()->getComm(), &comm);
+         int provided;
+         MPI_Query_thread(&provided);
+         threaded = provided == MPI_THREAD_MULTIPLE;
+         const std::array<FsIndex_t, 3>& localSize = grid.getLocalSize();
+         snapshot.resize((size_t)localSize[0] * localSize[1] * localSize[2]);
+      }
+
+      /*! Snapshot the grid's interior and start writing it into a checkpoint file, after
+       * waiting for the previous one to be written. Collective over the grid's tasks;
+       * non-FS tasks return at once. Throws if the previous write failed, or, without a
+       * background thread, if this one did.
+       * \param grid The grid to checkpoint
+       * \param path Name of the file, which is overwritten if it exists
+       * \param executor Parallel backend of the snapshot copy
+       */
+      template<typename Grid, typename Executor = FsGridOpenMP>
+      void start(Grid& grid, const std::string& path, Executor&& executor = Executor()) {
+         if(comm == MPI_COMM_NULL) {
+            return;
+         }
+         wait();
+         // One row of cells per work item
+         const std::array<FsIndex_t, 3> localSize = grid.getLocalSize();
+         T* rows = snapshot.data();
+         executor.parallelFor((size_t)localSize[1] * localSize[2], [&grid, &localSize, rows](size_t row) {
+            const FsIndex_t y = row % localSize[1];
+            const FsIndex_t z = row / localSize[1];
+            grid.packBox({0, y, z}, {localSize[0], 1, 1}, rows + row * localSize[0]);
+         });
 
-         return &data[index];
+         header = FsGridCheckpointIO::makeHeader(sizeof(T), grid.getGlobalSize(), {grid.DX, grid.DY, grid.DZ},
+               grid.physicalGlobalStart);
+         globalSize = grid.getGlobalSize();
+         localStart = grid.getLocalStart();
+         this->localSize = localSize;
+         this->path = path;
+         done = false;
+         if(threaded) {
+            writer = std::thread(&FsGridAsyncCheckpoint::write, this);
+         } else {
+            // Without a writer thread nothing else would report a failed write
+            write();
+            wait();
+         }
       }
 
-      T* get(LocalID id) {
-         if(id < 0 || (unsigned int)id > data.size()) {
-            std::cerr << "Out-of-bounds access in FsGrid::get!" << std::endl
-               << "(LocalID = " << id << ", but storage space is " << data.size()
-               << ". Expect weirdness." << std::endl;
-            return NULL;
+      //! Whether the last started checkpoint has been written (on this task)
+      bool test() const {
+         return done;
+      }
+
+      //! Wait until the last started checkpoint has been written, and throw if that failed
+      void wait() {
+         if(writer.joinable()) {
+            writer.join();
+         }
+         if(error) {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
          }
-         return &data[id];
       }
 
-      /*! Get the physical coordinates in the global simulation space for
-       * the given cell.
-       *
-       * \param x local x-Coordinate, in cells
-       * \param y local y-Coordinate, in cells
-       * \param z local z-Coordinate, in cells
+      /*!
+       *  MPI calls fail after the main program called MPI_Finalize(),
+       *  so this can be used instead of the destructor. Waits for an ongoing write.
        */
-      std::array<double, 3> getPhysicalCoords(int x, int y, int z) {
-         std::array<double, 3> coords;
-         coords[0] = physicalGlobalStart[0] + (localStart[0]+x)*DX;
-         coords[1] = physicalGlobalStart[1] + (localStart[1]+y)*DY;
-         coords[2] = physicalGlobalStart[2] + (localStart[2]+z)*DZ;
+      void finalize() noexcept {
+         if(writer.joinable()) {
+            writer.join();
+         }
+         if(comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&comm);
+            comm = MPI_COMM_NULL;
+         }
+      }
 
-         return coords;
+      ~FsGridAsyncCheckpoint() {
+         finalize();
       }
 
-      /*! Debugging output helper function. Allows for nicely formatted printing
-       * of grid contents. Since the grid data format is varying, the actual
-       * printing should be done in a lambda passed to this function. Example usage
-       * to plot |B|:
-       *
-       * perBGrid.debugOutput([](const std::array<Real, fsgrids::bfield::N_BFIELD>& a)->void{
-       *     cerr << sqrt(a[0]*a[0]+a[1]*a[1]+a[2]*a[2]) << ", ";
-       * });
-       *
-       * \param func Function pointer (or lambda) which is called with a cell reference,
-       * in order. Use std::cerr in it to print desired value.
+      FsGridAsyncCheckpoint(const FsGridAsyncCheckpoint&) = delete;
+      FsGridAsyncCheckpoint& operator=(const FsGridAsyncCheckpoint&) = delete;
+
+   private:
+      //! Write the snapshot, collectively over comm; errors are kept for wait()
+      void write() {
+         MPI_Datatype cellType = MPI_DATATYPE_NULL;
+         try {
+            MPI_File file = FsGridCheckpointIO::open(path, MPI_MODE_CREATE | MPI_MODE_WRONLY, comm);
+            MPI_File_set_size(file, 0);
+            int rank;
+            MPI_Comm_rank(comm, &rank);
+            if(rank == 0) {
+               FsGridCheckpointIO::check(MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE), path);
+            }
+            MPI_Type_contiguous(sizeof(T), MPI_BYTE, &cellType);
+            MPI_Type_commit(&cellType);
+            FsGridCheckpointIO::setView(file, header.dataOffset, cellType, globalSize, localStart, localSize, path);
+            const int status = MPI_File_write_all(file, snapshot.data(), snapshot.size(), cellType, MPI_STATUS_IGNORE);
+            MPI_File_close(&file);
+            FsGridCheckpointIO::check(status, path);
+         } catch(...) {
+            error = std::current_exception();
+         }
+         if(cellType != MPI_DATATYPE_NULL) {
+            MPI_Type_free(&cellType);
+         }
+         done = true;
+      }
+
+      MPI_Comm comm = MPI_COMM_NULL; //!< Duplicate of the grid's communicator, used only by the writer
+      bool threaded = false; //!< Whether writes happen in the background
+      std::vector<T> snapshot; //!< Copy of the interior cells, in x-fastest order
+      std::thread writer;
+      std::atomic<bool> done = true;
+      std::exception_ptr error;
+
+      // What the snapshot belongs to
+      FsGridCheckpointHeader header;
+      std::string path;
+      std::array<FsSize_t, 3> globalSize;
+      std::array<FsIndex_t, 3> localStart;
+      std::array<FsIndex_t, 3> localSize;
+};
+
+/*! Reader of chunked FsGrid output files (see FsGrid::writeChunked()), for post-processing
+ * tools. The file is mapped into memory, so opening it is cheap however large it is, and
+ * reading a box only touches the pages of the chunks it overlaps. This needs FSGRID_USE_POSIX
+ * to be defined and mmap() to be available, otherwise the whole file is loaded instead.
+ * This doesn't need MPI.
+ */
+class FsGridChunkedReader : public FsGridTools {
+   public:
+
+      /*! Open a file. Throws if it can't be read or isn't a chunked FsGrid file.
+       * \param path Name of the file
        */
-      void debugOutput(void (func)(const T&)) {
-         int xmin=0,xmax=1;
-         int ymin=0,ymax=1;
-         int zmin=0,zmax=1;
-         if(localSize[0] > 1) {
-            xmin = -stencil; xmax = localSize[0]+stencil;
+      explicit FsGridChunkedReader(const std::string& path) {
+#ifdef FSGRID_MMAP
+         const int fd = open(path.c_str(), O_RDONLY);
+         struct stat info;
+         if(fd >= 0 && fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(FsGridChunkedHeader)) {
+            size = info.st_size;
+            void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if(p != MAP_FAILED) {
+               mapping = static_cast<const char*>(p);
+            }
          }
-         if(localSize[1] > 1) {
-            ymin = -stencil; ymax = localSize[1]+stencil;
+         if(fd >= 0) {
+            close(fd);
          }
-         if(localSize[2] > 1) {
-            zmin = -stencil; zmax = localSize[2]+stencil;
+         data = mapping;
+#else
+         if(FILE* f = fopen(path.c_str(), "rb")) {
+            fseek(f, 0, SEEK_END);
+            contents.resize(ftell(f));
+            fseek(f, 0, SEEK_SET);
+            if(fread(contents.data(), 1, contents.size(), f) == contents.size()) {
+               data = contents.data();
+               size = contents.size();
+            }
+            fclose(f);
          }
-         for(int z=zmin; z<zmax; z++) {
-            for(int y=ymin; y<ymax; y++) {
-               for(int x=xmin; x<xmax; x++) {
-                  func(*get(x,y,z));
-               }
-               std::cerr << std::endl;
+#endif
+         if(data == nullptr || size < sizeof(FsGridChunkedHeader) || !getHeader().valid()
+               || getHeader().indexOffset > size
+               || getHeader().numChunks > (size - getHeader().indexOffset) / sizeof(FsGridChunkEntry)) {
+            std::cerr << "FsGridChunkedReader can't read " << path << " as a chunked FsGrid file." << std::endl;
+            unmap();
+            throw std::runtime_error("FsGridChunkedReader open failed");
+         }
+         for(size_t chunk = 0; chunk < getNumChunks(); chunk++) {
+            if(!validChunk(getChunk(chunk))) {
+               std::cerr << "FsGridChunkedReader: index entry " << chunk << " of " << path
+                  << " lies outside of the file or the grid." << std::endl;
+               unmap();
+               throw std::runtime_error("FsGridChunkedReader corrupt index");
             }
-            std::cerr << " - - - - - - - - " << std::endl;
          }
       }
 
-      /*! Get the rank of this CPU in the FsGrid communicator */
-      int getRank() {
-        return rank;
+      ~FsGridChunkedReader() {
+         unmap();
       }
 
-      /*! Get the number of ranks in the FsGrid communicator */
-      int getSize() {
-        return ntasksPerDim[0] * ntasksPerDim[1] * ntasksPerDim[2];
+      FsGridChunkedReader(const FsGridChunkedReader&) = delete;
+      FsGridChunkedReader& operator=(const FsGridChunkedReader&) = delete;
+
+      const FsGridChunkedHeader& getHeader() const {
+         return *reinterpret_cast<const FsGridChunkedHeader*>(data);
       }
 
-      /*! Get in which directions, if any, this grid is periodic */
-      std::array<bool, 3>& getPeriodic() {
-        return periodic;
+      std::array<FsSize_t, 3> getGlobalSize() const {
+         const FsGridChunkedHeader& header = getHeader();
+         return {(FsSize_t)header.globalSize[0], (FsSize_t)header.globalSize[1], (FsSize_t)header.globalSize[2]};
       }
 
-      /*! Perform an MPI_Allreduce with this grid's internal communicator
-       * Function syntax is identical to MPI_Allreduce, except the final (communicator
-       * argument will not be needed) */
-      int Allreduce(void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op) {
-         
-         // If a normal FS-rank
-         if(rank != -1){
-            return MPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm3d);
-         }
-         // If a non-FS rank, no need to communicate
-         else{
-            int datatypeSize;
-            MPI_Type_size(datatype, &datatypeSize);
-            for(int i = 0; i < count * datatypeSize; ++i)
-               ((char*)recvbuf)[i] = ((char*)sendbuf)[i];
-            return MPI_ERR_RANK; // This is ok for a non-FS rank
-         }
+      int getComponents() const {
+         return getHeader().components;
       }
 
-      /*! Get the decomposition array*/
-      std::array<Task_t, 3>& getDecomposition(){
-         return ntasksPerDim;
+      size_t getNumChunks() const {
+         return getHeader().numChunks;
       }
 
-      /*! Physical grid spacing and physical coordinate space start.
-       * TODO: Should this be private and have accesor-functions?
-       */
-      double DX,DY,DZ;
-      std::array<double,3> physicalGlobalStart;
+      const FsGridChunkEntry& getChunk(size_t chunk) const {
+         return reinterpret_cast<const FsGridChunkEntry*>(data + getHeader().indexOffset)[chunk];
+      }
 
-   private:
-      //! MPI Cartesian communicator used in this grid
-      MPI_Comm comm1d = MPI_COMM_NULL;
-      MPI_Comm comm1d_aux = MPI_COMM_NULL;
-      MPI_Comm comm3d = MPI_COMM_NULL;
-      MPI_Comm comm3d_aux = MPI_COMM_NULL;
-      int rank; //!< This task's rank in the communicator
-      std::vector<MPI_Request> requests;
-      uint numRequests;
+      /*! Zero-copy access to one component of a chunk, an x-fastest array of the chunk's cells.
+       * Compressed chunks can't be accessed this way (see readBox()).
+       * \param chunk Index of the chunk
+       * \param component Index of the component
+       * \return Pointer into the mapped file, valid as long as the reader
+       */
+      template<typename Real> const Real* getChunkComponent(size_t chunk, int component) const {
+         const FsGridChunkEntry& entry = getChunk(chunk);
+         checkComponents<Real>(component, 1);
+         if(entry.codec != 0) {
+            std::cerr << "FsGridChunkedReader: chunk " << chunk << " is encoded and can't be used in place." << std::endl;
+            throw std::runtime_error("FsGridChunkedReader encoded chunk");
+         }
+         return reinterpret_cast<const Real*>(data + entry.offset) + component * entry.cells();
+      }
 
-      std::array<int, 27> neighbour; //!< Tasks of the 26 neighbours (plus ourselves)
-      std::vector<char> neighbour_index; //!< Lookup table from rank to index in the neighbour array
+      /*! Copy a box of cells into a buffer, in x-fastest order with numComponents values per cell.
+       * Only chunks overlapping the box are touched, and decompressed if need be.
+       * \param start Global coordinates of the box's first cell
+       * \param boxSize Size of the box, in cells
+       * \param firstComponent First component to read
+       * \param numComponents Number of consecutive components to read
+       * \param buffer Destination, with room for numComponents values for every cell of the box
+       */
+      template<typename Real> void readBox(const std::array<FsIndex_t, 3>& start, const std::array<FsIndex_t, 3>& boxSize,
+            int firstComponent, int numComponents, Real* buffer) const {
+         checkComponents<Real>(firstComponent, numComponents);
+         std::vector<Real> decoded;
+         for(size_t chunk = 0; chunk < getNumChunks(); chunk++) {
+            const FsGridChunkEntry& entry = getChunk(chunk);
+            std::array<FsIndex_t, 3> lower, upper;
+            bool overlaps = true;
+            for(int i=0; i<3; i++) {
+               lower[i] = std::max<FsIndex_t>(start[i], entry.start[i]);
+               upper[i] = std::min<FsIndex_t>(start[i] + boxSize[i], entry.start[i] + entry.size[i]);
+               overlaps = overlaps && lower[i] < upper[i];
+            }
+            if(!overlaps) {
+               continue;
+            }
+            // values[c * cells + i] is component firstComponent + c of the chunk's cell i
+            const size_t cells = entry.cells();
+            const Real* values;
+            if(entry.codec == FsGridCompression::none) {
+               values = getChunkComponent<Real>(chunk, firstComponent);
+            } else {
+               decoded.resize(cells * numComponents);
+               FsGridCodec::decode(entry.codec, data + entry.offset, cells, getComponents(), sizeof(Real),
+                     getHeader().quantum, firstComponent, numComponents, reinterpret_cast<char*>(decoded.data()));
+               values = decoded.data();
+            }
+            for(FsIndex_t z = lower[2]; z < upper[2]; z++) {
+               for(FsIndex_t y = lower[1]; y < upper[1]; y++) {
+                  const size_t from = (((size_t)z - entry.start[2]) * entry.size[1] + (y - entry.start[1])) * entry.size[0]
+                     + (lower[0] - entry.start[0]);
+                  Real* to = buffer + ((((size_t)z - start[2]) * boxSize[1] + (y - start[1])) * boxSize[0]
+                     + (lower[0] - start[0])) * numComponents;
+                  for(FsIndex_t x = 0; x < upper[0] - lower[0]; x++) {
+                     for(int c=0; c<numComponents; c++) {
+                        to[x * numComponents + c] = values[c * cells + from + x];
+                     }
+                  }
+               }
+            }
+         }
+      }
 
-      // We have, fundamentally, two different coordinate systems we're dealing with:
-      // 1) Task grid in the MPI_Cartcomm
-      std::array<Task_t, 3> ntasksPerDim; //!< Number of tasks in each direction
-      std::array<Task_t, 3> taskPosition; //!< This task's position in the 3d task grid
-      // 2) Cell numbers in global and local view
+   private:
+      //! Whether a chunk's box lies within the grid, and its payload within the file
+      bool validChunk(const FsGridChunkEntry& entry) const {
+         const FsGridChunkedHeader& header = getHeader();
+         for(int i=0; i<3; i++) {
+            if(entry.start[i] > header.globalSize[i] || entry.size[i] > header.globalSize[i] - entry.start[i]) {
+               return false;
+            }
+         }
+         if(entry.offset > size || entry.bytes > size - entry.offset) {
+            return false;
+         }
+         // Plain payloads are read in place, encoded ones start with the byte count of each component's stream
+         if(entry.codec == FsGridCompression::none) {
+            return entry.bytes >= entry.cells() * header.components * header.componentBytes;
+         }
+         if(entry.bytes < header.components * sizeof(uint64_t)) {
+            return false;
+         }
+         uint64_t remaining = entry.bytes - header.components * sizeof(uint64_t);
+         for(uint32_t c=0; c<header.components; c++) {
+            uint64_t streamBytes;
+            std::copy(data + entry.offset + c * sizeof(uint64_t), data + entry.offset + (c + 1) * sizeof(uint64_t),
+                  reinterpret_cast<char*>(&streamBytes));
+            if(streamBytes > remaining) {
+               return false;
+            }
+            remaining -= streamBytes;
+         }
+         return true;
+      }
 
-      std::array<bool, 3> periodic; //!< Information about whether a given direction is periodic
-      std::array<FsSize_t, 3> globalSize; //!< Global size of the simulation space, in cells
-      std::array<FsIndex_t, 3> localSize;  //!< Local size of simulation space handled by this task (without ghost cells)
-      std::array<FsIndex_t, 3> storageSize;  //!< Local size of simulation space handled by this task (including ghost cells)
-      std::array<FsIndex_t, 3> localStart; //!< Offset of the local
-                                          //!coordinate system against
-                                          //!the global one
+      template<typename Real> void checkComponents(int firstComponent, int numComponents) const {
+         if(sizeof(Real) != getHeader().componentBytes || firstComponent < 0 || numComponents < 0
+               || firstComponent + numComponents > getComponents()) {
+            std::cerr << "FsGridChunkedReader: components " << firstComponent << " to " << firstComponent + numComponents
+               << " of " << sizeof(Real) << " bytes requested from cells of " << getComponents() << " components of "
+               << getHeader().componentBytes << " bytes." << std::endl;
+            throw std::runtime_error("FsGridChunkedReader component mismatch");
+         }
+      }
 
-      std::array<MPI_Datatype, 27> neighbourSendType; //!< Datatype for sending data
-      std::array<MPI_Datatype, 27> neighbourReceiveType; //!< Datatype for receiving data
+      void unmap() noexcept {
+#ifdef FSGRID_MMAP
+         if(mapping != nullptr) {
+            munmap(const_cast<char*>(mapping), size);
+            mapping = nullptr;
+         }
+#endif
+         data = nullptr;
+      }
 
-      //! Actual storage of field data
-      std::vector<T> data;
+      const char* data = nullptr; //!< Contents of the file
+      size_t size = 0; //!< Size of the file, in bytes
+      const char* mapping = nullptr; //!< Memory mapping of the file, if mmap() is used
+      std::vector<char> contents; //!< Contents of the file, if mmap() isn't used
 };
@@ -21,10 +21,9 @@
   along with fsgrid.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-template<class T, int stencil> void timeit(std::array<int32_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+template<class T, int stencil> void timeit(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
    double t1,t2;   
-   FsGridCouplingInformation gridCoupling;
-   FsGrid<T ,stencil> testGrid(globalSize, MPI_COMM_WORLD, isPeriodic, gridCoupling);
+   FsGrid<T ,stencil> testGrid(globalSize, MPI_COMM_WORLD, isPeriodic);
    int rank,size;
    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
    MPI_Comm_size(MPI_COMM_WORLD, &size);
@@ -41,21 +40,1232 @@ template<class T, int stencil> void timeit(std::array<int32_t, 3> globalSize, st
       printf("%g s per update: nprocs %d, grid is %d x %d x %d, stencil %d, element size %ld \n", (t2 - t1)/iterations, size, globalSize[0], globalSize[1], globalSize[2], stencil, sizeof(*testGrid.get(0,0,0)));
 }
 
+template<class T, int stencil> void timeCoupling(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2;
+   FsGrid<T ,stencil> testGrid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank,size;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+   // Host cells are dealt out round-robin, so that nearly all of them live on another task
+   std::vector<std::pair<FsGridTools::GlobalID, size_t>> cells;
+   const FsGridTools::GlobalID nCells = (FsGridTools::GlobalID)globalSize[0] * globalSize[1] * globalSize[2];
+   for(FsGridTools::GlobalID id = rank; id < nCells; id += size) {
+      cells.push_back(std::make_pair(id, cells.size()));
+   }
+   std::vector<T> hostData(cells.size());
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   FsGridCoupling<T> coupling(testGrid, MPI_COMM_WORLD, cells);
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g s coupling setup: nprocs %d, grid is %d x %d x %d\n", t2 - t1, size, globalSize[0], globalSize[1], globalSize[2]);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      coupling.copyIn(testGrid, hostData.data());
+      coupling.copyOut(testGrid, hostData.data());
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g s per coupling copyIn + copyOut: nprocs %d, element size %ld \n", (t2 - t1)/iterations, size, sizeof(T));
+}
+
+template<class T, int stencil> void timeLookup(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2;
+   FsGrid<T ,stencil> testGrid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+   const size_t nCells = (size_t)globalSize[0] * globalSize[1] * globalSize[2];
+   std::vector<FsGridTools::GlobalID> ids(nCells);
+   for(size_t i = 0; i < nCells; i++) {
+      ids[i] = i;
+   }
+   std::vector<FsGridTools::Task_t> tasks(nCells);
+   std::vector<FsGridTools::LocalID> localIDs(nCells);
+   std::vector<FsGridTools::Task_t> referenceTasks(nCells);
+   std::vector<FsGridTools::LocalID> referenceIDs(nCells);
+
+   // Baseline: the original lookup, asking MPI_Cart_rank for every cell
+   MPI_Comm comm3d = testGrid.getTopology()->getComm();
+   std::array<FsGridTools::Task_t, 3> ntasks = testGrid.getDecomposition();
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      for(size_t j = 0; j < nCells; j++) {
+         std::array<FsGridTools::FsIndex_t, 3> cell = FsGridTools::globalIDtoCellCoord(ids[j], globalSize);
+         std::array<int, 3> taskIndex;
+         for(int d=0; d<3; d++) {
+            taskIndex[d] = FsGridTools::calcTaskIndex(globalSize[d], ntasks[d], cell[d]);
+         }
+         MPI_Cart_rank(comm3d, taskIndex.data(), &referenceTasks[j]);
+         FsGridTools::LocalID localID = 0;
+         FsGridTools::LocalID stride = 1;
+         for(int d=0; d<3; d++) {
+            if(globalSize[d] > 1) {
+               localID += stride * (cell[d] - FsGridTools::calcLocalStart(globalSize[d], ntasks[d], taskIndex[d]) + stencil);
+               stride *= FsGridTools::calcLocalSize(globalSize[d], ntasks[d], taskIndex[d]) + 2 * stencil;
+            }
+         }
+         referenceIDs[j] = localID;
+      }
+   }
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g cells/s with MPI_Cart_rank\n", nCells * iterations / (t2 - t1));
+
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      for(size_t j = 0; j < nCells; j++) {
+         std::pair<int, FsGridTools::LocalID> owner = testGrid.getTaskForGlobalID(ids[j]);
+         tasks[j] = owner.first;
+         localIDs[j] = owner.second;
+      }
+   }
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g cells/s with getTaskForGlobalID\n", nCells * iterations / (t2 - t1));
+
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      testGrid.getTasksForGlobalIDs(nCells, ids.data(), tasks.data(), localIDs.data());
+   }
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g cells/s with getTasksForGlobalIDs\n", nCells * iterations / (t2 - t1));
+
+   if(tasks != referenceTasks || localIDs != referenceIDs) {
+      fprintf(stderr, "Lookup results differ from MPI_Cart_rank!\n");
+      MPI_Abort(MPI_COMM_WORLD, 1);
+   }
+}
+
+template<class T, int stencil> void timeConstruction(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2;
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      FsGrid<T ,stencil> testGrid(globalSize, MPI_COMM_WORLD, isPeriodic);
+      testGrid.updateGhostCells();
+   }
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g s per grid with its own topology\n", (t2 - t1) / iterations);
+
+   FsGrid<T ,stencil> parentGrid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      FsGrid<T ,stencil> testGrid(parentGrid.getTopology());
+      testGrid.updateGhostCells();
+   }
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g s per grid on a shared topology\n", (t2 - t1) / iterations);
+}
+
+template<int stencil> void timeTiling(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   typedef std::array<double, 3> Vec;
+   double t1,t2;
+   FsGrid<Vec, stencil> E(globalSize, MPI_COMM_WORLD, isPeriodic);
+   FsGrid<Vec, stencil> B(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   E.forEachCell([](int x, int y, int z, Vec* e) {
+      *e = {(double)x, (double)y, (double)z};
+   });
+
+   // Curl-like kernel with a 6-point stencil
+   auto curl = [](int x, int y, int z, FsGridView<Vec>::Cell e, Vec& b) {
+      b[0] = e.at(0,1,0)[2] - e.at(0,-1,0)[2] - e.at(0,0,1)[1] + e.at(0,0,-1)[1];
+      b[1] = e.at(0,0,1)[0] - e.at(0,0,-1)[0] - e.at(1,0,0)[2] + e.at(-1,0,0)[2];
+      b[2] = e.at(1,0,0)[1] - e.at(-1,0,0)[1] - e.at(0,1,0)[0] + e.at(0,-1,0)[0];
+   };
+
+   const std::array<FsGridTools::FsIndex_t, 3> shapes[] = {
+      {1024, 1, 1}, {1024, 4, 4}, {1024, 8, 8}, {1024, 16, 16}, {1024, 32, 32}, {64, 8, 8}, {32, 32, 32}};
+   for(const auto& shape : shapes) {
+      FsGridView<Vec> b = B.getView();
+      E.setTileSize(shape);
+      MPI_Barrier(MPI_COMM_WORLD);
+      t1=MPI_Wtime();
+      for(int i = 0; i < iterations; i++) {
+         E.forEachInterior([&](int x, int y, int z, FsGridView<Vec>::Cell e) {
+            curl(x, y, z, e, b(x, y, z));
+         });
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      t2=MPI_Wtime();
+      if(rank==0)
+         printf("%g s per curl with tile size %d x %d x %d, grid is %d x %d x %d\n", (t2 - t1)/iterations,
+               shape[0], shape[1], shape[2], globalSize[0], globalSize[1], globalSize[2]);
+   }
+}
+
+template<class Layout> void timeLayout(const char* name, std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   // Typical field solver cell, of which the kernels only touch a few components
+   typedef std::array<double, 16> Cell;
+   double t1,t2;
+   FsGrid<Cell, 2, Layout> E(globalSize, MPI_COMM_WORLD, isPeriodic);
+   FsGrid<Cell, 2, Layout> B(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   const std::array<FsGridTools::FsIndex_t, 3> L = E.getLocalSize();
+
+   auto ex = E.getComponentView(0);
+   auto ey = E.getComponentView(1);
+   auto ez = E.getComponentView(2);
+   auto bx = B.getComponentView(0);
+   auto by = B.getComponentView(1);
+   auto bz = B.getComponentView(2);
+   auto dbx = B.getComponentView(3);
+   E.forEachCell([&](int x, int y, int z) {
+      ex(x, y, z) = x;
+      ey(x, y, z) = y;
+      ez(x, y, z) = z;
+   });
+   E.updateGhostCells();
+
+   auto curlCells = [&](int y, int z, int xBegin, int xEnd) {
+      for(int x = xBegin; x < xEnd; x++) {
+         bx(x, y, z) = ez(x, y+1, z) - ez(x, y-1, z) - ey(x, y, z+1) + ey(x, y, z-1);
+         by(x, y, z) = ex(x, y, z+1) - ex(x, y, z-1) - ez(x+1, y, z) + ez(x-1, y, z);
+         bz(x, y, z) = ey(x+1, y, z) - ey(x-1, y, z) - ex(x, y+1, z) + ex(x, y-1, z);
+      }
+   };
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      for(int z = 1; z < L[2] - 1; z++) {
+         for(int y = 1; y < L[1] - 1; y++) {
+            if constexpr (Layout::tiled) {
+               // Work tile by tile (tiles start at x = -stencil), so that each lane loop is a plain
+               // vector loop. The x-neighbours of the first and last lane live in the previous and next tile.
+               // Only tiles lying entirely within [1, L[0]-1) are done this way, the cells left over at
+               // either end are done one by one, so that exactly the cells of the AoS loop are computed.
+               constexpr int W = Layout::tileWidth;
+               const size_t next = ex.getTileStride();
+               const int firstTile = -2 + (3 + W - 1) / W * W;
+               const int endTiles = firstTile + std::max(0, L[0] - 1 - firstTile) / W * W;
+               curlCells(y, z, 1, std::min(firstTile, L[0] - 1));
+               curlCells(y, z, endTiles, L[0] - 1);
+               for(int x = firstTile; x < endTiles; x += W) {
+                  double* bxl = bx.tile(x, y, z);
+                  double* byl = by.tile(x, y, z);
+                  double* bzl = bz.tile(x, y, z);
+                  const double* exym = ex.tile(x, y-1, z);
+                  const double* exyp = ex.tile(x, y+1, z);
+                  const double* exzm = ex.tile(x, y, z-1);
+                  const double* exzp = ex.tile(x, y, z+1);
+                  const double* ey0 = ey.tile(x, y, z);
+                  const double* eyzm = ey.tile(x, y, z-1);
+                  const double* eyzp = ey.tile(x, y, z+1);
+                  const double* ez0 = ez.tile(x, y, z);
+                  const double* ezym = ez.tile(x, y-1, z);
+                  const double* ezyp = ez.tile(x, y+1, z);
+                  double eyxm[W], eyxp[W], ezxm[W], ezxp[W];
+                  for(int l = 0; l < W; l++) {
+                     eyxm[l] = l > 0 ? ey0[l-1] : (ey0 - next)[W-1];
+                     eyxp[l] = l < W-1 ? ey0[l+1] : (ey0 + next)[0];
+                     ezxm[l] = l > 0 ? ez0[l-1] : (ez0 - next)[W-1];
+                     ezxp[l] = l < W-1 ? ez0[l+1] : (ez0 + next)[0];
+                  }
+                  for(int l = 0; l < W; l++) {
+                     bxl[l] = ezyp[l] - ezym[l] - eyzp[l] + eyzm[l];
+                     byl[l] = exzp[l] - exzm[l] - ezxp[l] + ezxm[l];
+                     bzl[l] = eyxp[l] - eyxm[l] - exyp[l] + exym[l];
+                  }
+               }
+            } else {
+               curlCells(y, z, 1, L[0] - 1);
+            }
+         }
+      }
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g s per curl with %s layout, grid is %d x %d x %d\n", (t2 - t1)/iterations, name, globalSize[0], globalSize[1], globalSize[2]);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      for(int z = 0; z < L[2]; z++) {
+         for(int y = 0; y < L[1]; y++) {
+            for(int x = 1; x < L[0] - 1; x++) {
+               dbx(x, y, z) = 0.5 * (bx(x+1, y, z) - bx(x-1, y, z));
+            }
+         }
+      }
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g s per x-derivative with %s layout\n", (t2 - t1)/iterations, name);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      E.updateGhostCells(0, 3);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%g s per ghost update of 3 components with %s layout\n", (t2 - t1)/iterations, name);
+}
+
+template<class Layout> void timePadding(const char* name, std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   // 7-point Laplacian, whose y- and z-neighbours conflict in cache if the storage strides are large powers of two
+   double t1,t2;
+   FsGrid<std::array<double, 1>, 1, Layout> u(globalSize, MPI_COMM_WORLD, isPeriodic);
+   FsGrid<std::array<double, 1>, 1, Layout> v(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   const std::array<FsGridTools::FsIndex_t, 3> L = u.getLocalSize();
+   auto uv = u.getComponentView(0);
+   auto vv = v.getComponentView(0);
+   u.forEachCell([&](int x, int y, int z) {
+      uv(x, y, z) = x + y + z;
+   });
+   u.updateGhostCells();
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      for(int z = 0; z < L[2]; z++) {
+         for(int y = 0; y < L[1]; y++) {
+            for(int x = 0; x < L[0]; x++) {
+               vv(x, y, z) = uv(x-1, y, z) + uv(x+1, y, z) + uv(x, y-1, z) + uv(x, y+1, z)
+                  + uv(x, y, z-1) + uv(x, y, z+1) - 6 * uv(x, y, z);
+            }
+         }
+      }
+   }
+   t2=MPI_Wtime();
+   if(rank==0)
+      printf("%s: %g cells/s for the Laplacian, storage of %zu cells\n", name,
+            (double)L[0] * L[1] * L[2] * iterations / (t2 - t1), u.getStorageCells());
+   u.finalize();
+   v.finalize();
+}
+
+template<class Layout> void timeDimensions(const char* name, std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   // 5-point Laplacian through get(), plus ghost updates, on a 2D grid
+   double t1,t2,t3;
+   FsGrid<std::array<double, 1>, 1, Layout> u(globalSize, MPI_COMM_WORLD, isPeriodic);
+   FsGrid<std::array<double, 1>, 1, Layout> v(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   const std::array<FsGridTools::FsIndex_t, 3> L = u.getLocalSize();
+   u.forEachCell([&](int x, int y, int z) {
+      (*u.get(x, y, z))[0] = x + y;
+   });
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      u.updateGhostCells();
+   }
+   t2=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      for(int y = 0; y < L[1]; y++) {
+         for(int x = 0; x < L[0]; x++) {
+            (*v.get(x, y, 0))[0] = (*u.get(x-1, y, 0))[0] + (*u.get(x+1, y, 0))[0] + (*u.get(x, y-1, 0))[0]
+               + (*u.get(x, y+1, 0))[0] - 4 * (*u.get(x, y, 0))[0];
+         }
+      }
+   }
+   t3=MPI_Wtime();
+   if(rank==0)
+      printf("%s: %g s per ghost update, %g cells/s for the Laplacian through get()\n", name,
+            (t2 - t1)/iterations, (double)L[0] * L[1] * iterations / (t3 - t2));
+   u.finalize();
+   v.finalize();
+}
+
+template<class Layout> void timeCheckpoint(const char* name, std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2,t3;
+   FsGrid<std::array<double, 8>, 2, Layout> grid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   const char* path = "fsgrid_benchmark_checkpoint.bin";
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      grid.writeCheckpoint(path);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      grid.readCheckpoint(path);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t3=MPI_Wtime();
+   if(rank==0) {
+      const double bytes = (double)globalSize[0] * globalSize[1] * globalSize[2] * sizeof(std::array<double, 8>) * iterations;
+      printf("%s checkpoint: %g MB/s write, %g MB/s read\n", name, bytes / (t2 - t1) / 1e6, bytes / (t3 - t2) / 1e6);
+      remove(path);
+   }
+   grid.finalize();
+}
+
+void timeChunked(const char* name, FsGridCompression compression, std::array<FsGridTools::FsSize_t, 3> globalSize,
+      std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2,t3;
+   FsGrid<std::array<double, 8>, 2> grid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   const char* path = "fsgrid_benchmark_chunked.bin";
+   // A smooth field, so that compression has something to work with
+   const std::array<FsGridTools::FsIndex_t, 3> start = grid.getLocalStart();
+   grid.forEachCell([&](int x, int y, int z, std::array<double, 8>* cell) {
+      for(int c = 0; c < 8; c++) {
+         (*cell)[c] = std::sin(0.05 * (start[0] + x) + c) * std::cos(0.03 * (start[1] + y)) + 0.01 * (start[2] + z);
+      }
+   });
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      grid.writeChunked(path, {64, 64, 64}, compression);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   if(rank==0) {
+      // One component of an xy-plane, as a quick-look tool would read it
+      FsGridChunkedReader reader(path);
+      std::vector<double> slice((size_t)globalSize[0] * globalSize[1]);
+      for(int i = 0; i < iterations; i++) {
+         reader.readBox<double>({0, 0, (FsGridTools::FsIndex_t)globalSize[2] / 2},
+               {(FsGridTools::FsIndex_t)globalSize[0], (FsGridTools::FsIndex_t)globalSize[1], 1}, 3, 1, slice.data());
+      }
+      t3=MPI_Wtime();
+      size_t fileBytes = 0;
+      for(size_t i = 0; i < reader.getNumChunks(); i++) {
+         fileBytes += reader.getChunk(i).bytes;
+      }
+      const double bytes = (double)globalSize[0] * globalSize[1] * globalSize[2] * sizeof(std::array<double, 8>);
+      printf("Chunked output, %s: %g MB/s write, compression ratio %g, %g s per slice read\n", name,
+            bytes * iterations / (t2 - t1) / 1e6, bytes / fileBytes, (t3 - t2) / iterations);
+      remove(path);
+   }
+   grid.finalize();
+}
+
+void timeCoarsening(int factor, std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2;
+   FsGrid<std::array<double, 8>, 2> fine(globalSize, MPI_COMM_WORLD, isPeriodic);
+   std::array<FsGridTools::FsSize_t, 3> coarseSize;
+   for(int i = 0; i < 3; i++) {
+      coarseSize[i] = (globalSize[i] + factor - 1) / factor;
+   }
+   FsGrid<std::array<double, 8>, 1> coarse(coarseSize, MPI_COMM_WORLD, isPeriodic);
+   FsGridCoarsening<std::array<double, 8>> coarsening(fine, coarse, factor, MPI_COMM_WORLD);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      coarsening.execute(fine, coarse);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   if(rank==0) {
+      const double bytes = (double)globalSize[0] * globalSize[1] * globalSize[2] * sizeof(std::array<double, 8>) * iterations;
+      printf("Coarsening by %d: %g s per call, %g MB/s of fine data\n", factor, (t2 - t1) / iterations, bytes / (t2 - t1) / 1e6);
+   }
+   coarsening.finalize();
+   coarse.finalize();
+   fine.finalize();
+}
+
+void timeSlice(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2;
+   FsGrid<std::array<double, 8>, 2> grid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   std::vector<double> plane(rank == 0 ? globalSize[0] * globalSize[1] * 3 : 0);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      grid.extractSlice(2, globalSize[2] / 2, 0, 3, plane.data());
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   if(rank==0) {
+      printf("Slice extraction of 3 components: %g s per %u x %u plane\n", (t2 - t1) / iterations, (unsigned)globalSize[0], (unsigned)globalSize[1]);
+   }
+   grid.finalize();
+}
+
+void timeReduce(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2,t3;
+   typedef std::array<double, 8> Cell;
+   FsGrid<Cell, 2> grid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   grid.forEachCell([](int x, int y, int z, Cell* cell) {
+      for(int c = 0; c < 8; c++) {
+         (*cell)[c] = 1 + 0.001 * (x + y + z + c);
+      }
+   });
+   auto b2 = [](const Cell& c) { return c[0] * c[0] + c[1] * c[1] + c[2] * c[2]; };
+
+   // Separate passes and collectives for max |B|^2, total energy and min and max density
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   double separate[4];
+   for(int i = 0; i < iterations; i++) {
+      double local[4] = {0, 0, 1e300, 0};
+      grid.forEachCell([&](int, int, int, Cell* c) { local[0] = std::max(local[0], b2(*c)); }, FsGridSerial());
+      grid.forEachCell([&](int, int, int, Cell* c) { local[1] += (*c)[7]; }, FsGridSerial());
+      grid.forEachCell([&](int, int, int, Cell* c) { local[2] = std::min(local[2], (*c)[6]); }, FsGridSerial());
+      grid.forEachCell([&](int, int, int, Cell* c) { local[3] = std::max(local[3], (*c)[6]); }, FsGridSerial());
+      grid.Allreduce(&local[0], &separate[0], 1, MPI_DOUBLE, MPI_MAX);
+      grid.Allreduce(&local[1], &separate[1], 1, MPI_DOUBLE, MPI_SUM);
+      grid.Allreduce(&local[2], &separate[2], 1, MPI_DOUBLE, MPI_MIN);
+      grid.Allreduce(&local[3], &separate[3], 1, MPI_DOUBLE, MPI_MAX);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      grid.reduce<FsGridReduction::max, FsGridReduction::sum, FsGridReduction::min, FsGridReduction::argmax>(
+            [&](int, int, int, Cell* c) { return std::array<double, 4>{b2(*c), (*c)[7], (*c)[6], (*c)[6]}; }, FsGridSerial());
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t3=MPI_Wtime();
+   if(rank==0) {
+      printf("4 reductions: %g s per call separately, %g s per call fused\n", (t2 - t1) / iterations, (t3 - t2) / iterations);
+   }
+   grid.finalize();
+}
+
+void timeIallreduce(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int iterations){
+   double t1,t2,t3;
+   FsGrid<std::array<double, 8>, 2> grid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   auto work = [](int x, int y, int z, std::array<double, 8>* cell) {
+      (*cell)[0] = 0.5 * (*cell)[0] + x + y + z;
+   };
+   double dt = 1;
+
+   // A timestep limit reduced before, or while, doing the next stage's local work
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      double local = 1.0 / (rank + i + 1), global;
+      grid.Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_MIN);
+      grid.forEachCell(work);
+      dt = std::min(dt, global);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      auto global = grid.Iallreduce(1.0 / (rank + i + 1), MPI_MIN);
+      grid.forEachCell(work);
+      dt = std::min(dt, global.wait()[0]);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t3=MPI_Wtime();
+   if(rank==0) {
+      printf("Timestep reduction and local work: %g s per step blocking, %g s per step non-blocking (dt %g)\n",
+            (t2 - t1) / iterations, (t3 - t2) / iterations, dt);
+   }
+   grid.finalize();
+}
+
+void timeProbes(std::array<FsGridTools::FsSize_t, 3> globalSize, std::array<bool, 3> isPeriodic, int numProbes, int iterations){
+   double t1,t2,t3;
+   FsGrid<std::array<double, 8>, 2> grid(globalSize, MPI_COMM_WORLD, isPeriodic);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   grid.DX = grid.DY = grid.DZ = 1;
+   grid.physicalGlobalStart = {0, 0, 0};
+   grid.updateGhostCells();
+   // Probes scattered over the whole domain, so that most of them belong to other tasks
+   std::vector<std::array<double, 3>> positions(numProbes);
+   for(int i = 0; i < numProbes; i++) {
+      for(int d = 0; d < 3; d++) {
+         positions[i][d] = std::fmod((i + 1) * (0.618034 + 0.1 * d + 0.01 * rank), 1.0) * globalSize[d];
+      }
+   }
+   std::vector<double> values(numProbes * 3);
+
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   FsGridProbes<std::array<double, 8>> probes(grid, MPI_COMM_WORLD, positions);
+   MPI_Barrier(MPI_COMM_WORLD);
+   t2=MPI_Wtime();
+   for(int i = 0; i < iterations; i++) {
+      probes.sample(grid, 0, 3, values.data());
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+   t3=MPI_Wtime();
+   if(rank==0) {
+      printf("%d probes per task: %g s setup, %g s per sample\n", numProbes, t2 - t1, (t3 - t2) / iterations);
+   }
+   probes.finalize();
+   grid.finalize();
+}
+
+// Correctness checks of the features timed above, run before the timings. Each check
+// returns whether the result was right on this task; checkPassed() combines them.
+
+bool checkPassed(const char* name, bool ok){
+   int allOk = ok;
+   MPI_Allreduce(MPI_IN_PLACE, &allOk, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   if(rank==0)
+      printf("%s: %s\n", allOk ? "PASS" : "FAIL", name);
+   return allOk;
+}
+
+// Distinct, exactly representable value of component c of a global cell
+double checkValue(int c, int x, int y, int z){
+   return c * 1e6 + x + 1000.0 * y + 0.125 * z;
+}
+
+// Smooth value of component c of a global cell, which the codecs can compress
+double smoothValue(int c, int x, int y, int z){
+   return std::sin(0.05 * x + c) * std::cos(0.03 * y) + 0.01 * z;
+}
+
+// A decomposition over the same tasks as the given one, but along a different axis
+std::array<FsGridTools::Task_t, 3> otherDecomposition(const std::array<FsGridTools::Task_t, 3>& decomposition){
+   const FsGridTools::Task_t tasks = decomposition[0] * decomposition[1] * decomposition[2];
+   if(decomposition[0] == tasks) {
+      return {1, 1, tasks};
+   }
+   return {tasks, 1, 1};
+}
+
+template<class Grid, class F> void fillGrid(Grid& grid, F value){
+   const std::array<FsGridTools::FsIndex_t, 3> start = grid.getLocalStart();
+   grid.forEachCell([&](int x, int y, int z, auto cell) {
+      for(size_t c = 0; c < (*cell).size(); c++) {
+         (*cell)[c] = value(c, start[0] + x, start[1] + y, start[2] + z);
+      }
+   }, FsGridSerial());
+}
+
+template<class Grid, class F> bool gridMatches(Grid& grid, F value){
+   const std::array<FsGridTools::FsIndex_t, 3> start = grid.getLocalStart();
+   bool ok = true;
+   grid.forEachCell([&](int x, int y, int z, auto cell) {
+      for(size_t c = 0; c < (*cell).size(); c++) {
+         ok = ok && (*cell)[c] == value(c, start[0] + x, start[1] + y, start[2] + z);
+      }
+   }, FsGridSerial());
+   return ok;
+}
+
+template<class Source, class Target> bool transferRoundTrip(Source& source, Target& target){
+   typedef std::array<double, 2> Cell;
+   fillGrid(source, checkValue);
+   FsGridTransferPlan<Cell> there(source, target, MPI_COMM_WORLD);
+   FsGridTransferPlan<Cell> back(target, source, MPI_COMM_WORLD);
+   there.execute(source, target);
+   bool ok = gridMatches(target, checkValue);
+   fillGrid(source, [](int, int, int, int) { return 0.0; });
+   back.execute(target, source);
+   ok = ok && gridMatches(source, checkValue);
+   back.finalize();
+   there.finalize();
+   return ok;
+}
+
+bool checkTransferPlan(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 2> Cell;
+   FsGrid<Cell, 2> source(globalSize, MPI_COMM_WORLD, {true, false, true});
+   FsGrid<Cell, 1, FsGridLayoutSoA> target(globalSize, MPI_COMM_WORLD, {true, false, true},
+         otherDecomposition(source.getDecomposition()));
+   const bool ok = transferRoundTrip(source, target);
+   target.finalize();
+   source.finalize();
+   return checkPassed("TransferPlan round trip between decompositions", ok);
+}
+
+bool checkTransferToAllTasks(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 2> Cell;
+   int size;
+   MPI_Comm_size(MPI_COMM_WORLD, &size);
+   // The source grid lives on FSGRID_PROCS tasks (half of them, unless set), the target on all
+   const char* procs = getenv("FSGRID_PROCS");
+   const std::string previous = procs != NULL ? procs : "";
+   if(procs == NULL) {
+      setenv("FSGRID_PROCS", std::to_string(std::max(size / 2, 1)).c_str(), 1);
+   }
+   FsGrid<Cell, 2> source(globalSize, MPI_COMM_WORLD, {true, false, true});
+   unsetenv("FSGRID_PROCS");
+   FsGrid<Cell, 1, FsGridLayoutSoA> target(globalSize, MPI_COMM_WORLD, {true, false, true});
+   if(procs != NULL) {
+      setenv("FSGRID_PROCS", previous.c_str(), 1);
+   }
+   const bool ok = transferRoundTrip(source, target);
+   target.finalize();
+   source.finalize();
+   return checkPassed("TransferPlan round trip between FSGRID_PROCS tasks and all tasks", ok);
+}
+
+bool checkCoupling(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 2> Cell;
+   FsGrid<Cell, 2> grid(globalSize, MPI_COMM_WORLD, {true, false, true});
+   int rank,size;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &size);
+   // Host cells are dealt out round-robin and in reverse order
+   std::vector<std::pair<FsGridTools::GlobalID, size_t>> cells;
+   const FsGridTools::GlobalID nCells = (FsGridTools::GlobalID)globalSize[0] * globalSize[1] * globalSize[2];
+   for(FsGridTools::GlobalID id = nCells - 1 - rank; id >= 0; id -= size) {
+      cells.push_back(std::make_pair(id, cells.size()));
+   }
+   auto hostValue = [&](int c, FsGridTools::GlobalID id) {
+      return checkValue(c, id % globalSize[0], id / globalSize[0] % globalSize[1], id / globalSize[0] / globalSize[1]);
+   };
+   std::vector<Cell> hostData(cells.size());
+   for(const auto& cell : cells) {
+      hostData[cell.second] = {hostValue(0, cell.first), hostValue(1, cell.first)};
+   }
+   FsGridCoupling<Cell> coupling(grid, MPI_COMM_WORLD, cells);
+   coupling.copyIn(grid, hostData.data());
+   bool ok = gridMatches(grid, checkValue);
+   fillGrid(grid, [](int c, int x, int y, int z) { return -checkValue(c, x, y, z); });
+   coupling.copyOut(grid, hostData.data());
+   for(const auto& cell : cells) {
+      ok = ok && hostData[cell.second][0] == -hostValue(0, cell.first) && hostData[cell.second][1] == -hostValue(1, cell.first);
+   }
+   coupling.finalize();
+   grid.finalize();
+   return checkPassed("Coupling copyIn and copyOut", ok);
+}
+
+bool checkThreadPool(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 2> Cell;
+   FsGrid<Cell, 2> grid(globalSize, MPI_COMM_WORLD, {true, true, false});
+   FsGridThreadPool pool(3);
+   grid.setTileSize({8, 4, 2});
+   const std::array<FsGridTools::FsIndex_t, 3> start = grid.getLocalStart();
+   grid.forEachCell([&](int x, int y, int z, Cell* cell) {
+      for(int c = 0; c < 2; c++) {
+         (*cell)[c] = checkValue(c, start[0] + x, start[1] + y, start[2] + z);
+      }
+   }, pool);
+   bool ok = gridMatches(grid, checkValue);
+
+   // Interior and boundary together visit every cell exactly once
+   fillGrid(grid, [](int, int, int, int) { return 0.0; });
+   auto count = [](int, int, int, Cell* cell) {
+      (*cell)[0] += 1;
+   };
+   grid.forEachInterior(count, pool);
+   grid.forEachBoundary(count, pool);
+   grid.forEachCell([&](int, int, int, Cell* cell) {
+      ok = ok && (*cell)[0] == 1;
+   }, FsGridSerial());
+   grid.finalize();
+   return checkPassed("Cell iteration on a thread pool against a serial reference", ok);
+}
+
+// Every ghost cell of the given layout, after a full exchange and after one of components 1 and 2 only,
+// against the value of the cell it mirrors
+template<class Layout> bool checkGhostCells(const char* name, std::array<FsGridTools::FsSize_t, 3> globalSize,
+      std::array<bool, 3> periodic){
+   typedef std::array<double, 4> Cell;
+   const int stencil = 2;
+   FsGrid<Cell, stencil, Layout> grid(globalSize, MPI_COMM_WORLD, periodic);
+   const std::array<FsGridTools::FsIndex_t, 3> localSize = grid.getLocalSize();
+   const std::array<FsGridTools::FsIndex_t, 3> start = grid.getLocalStart();
+   const double unset = -1;
+   std::array<int, 3> ghosts;
+   for(int d = 0; d < 3; d++) {
+      ghosts[d] = globalSize[d] > 1 ? stencil : 0;
+   }
+
+   // Calls f(x, y, z, cell, global coordinates) for each ghost cell that mirrors an existing cell
+   auto forEachGhost = [&](auto f) {
+      if(grid.getRank() == -1) {
+         return;
+      }
+      for(int z = -ghosts[2]; z < localSize[2] + ghosts[2]; z++) {
+         for(int y = -ghosts[1]; y < localSize[1] + ghosts[1]; y++) {
+            for(int x = -ghosts[0]; x < localSize[0] + ghosts[0]; x++) {
+               const std::array<int, 3> local = {x, y, z};
+               std::array<long, 3> global;
+               bool ghost = false;
+               bool exists = true;
+               for(int d = 0; d < 3; d++) {
+                  ghost = ghost || local[d] < 0 || local[d] >= localSize[d];
+                  global[d] = start[d] + local[d];
+                  if(global[d] < 0 || global[d] >= (long)globalSize[d]) {
+                     exists = exists && periodic[d];
+                     global[d] = (global[d] + globalSize[d]) % globalSize[d];
+                  }
+               }
+               if(ghost && exists) {
+                  f(grid.get(grid.LocalIDForCoords(x, y, z)), global);
+               }
+            }
+         }
+      }
+   };
+   auto exchange = [&](auto value, int first, int num) {
+      fillGrid(grid, value);
+      forEachGhost([&](auto cell, const std::array<long, 3>&) {
+         for(int c = 0; c < 4; c++) {
+            (*cell)[c] = unset;
+         }
+      });
+      if(num == 4) {
+         grid.updateGhostCells();
+      } else {
+         grid.updateGhostCells(first, num);
+      }
+      bool ok = true;
+      forEachGhost([&](auto cell, const std::array<long, 3>& global) {
+         for(int c = 0; c < 4; c++) {
+            // Layouts keeping cells contiguous always exchange whole cells
+            const bool exchanged = Layout::cellsContiguous || (c >= first && c < first + num);
+            const double expected = exchanged ? value(c, global[0], global[1], global[2]) : unset;
+            ok = ok && (*cell)[c] == expected;
+         }
+      });
+      return ok;
+   };
+   const bool ok = exchange(checkValue, 0, 4) && exchange(smoothValue, 1, 2);
+   grid.finalize();
+   return checkPassed(name, ok);
+}
+
+// A grid on external storage has to behave exactly like one owning its storage
+bool checkExternalStorage(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 2> Cell;
+   FsGrid<Cell, 2> owner(globalSize, MPI_COMM_WORLD, {true, false, true});
+   fillGrid(owner, checkValue);
+   owner.updateGhostCells();
+
+   std::vector<Cell> wrappedBuffer(owner.getStorageCells());
+   FsGrid<Cell, 2> wrapped = FsGrid<Cell, 2>::wrap(wrappedBuffer.data(), wrappedBuffer.size(), owner.getTopology());
+   fillGrid(wrapped, checkValue);
+   wrapped.updateGhostCells();
+   bool ok = wrapped.getStorage() == wrappedBuffer.data()
+      && std::equal(wrappedBuffer.begin(), wrappedBuffer.end(), owner.getStorage());
+
+   std::vector<Cell> adoptedBuffer(owner.getStorageCells());
+   FsGrid<Cell, 2> adopting(owner.getTopology());
+   adopting.adoptStorage(adoptedBuffer.data(), adoptedBuffer.size());
+   fillGrid(adopting, checkValue);
+   adopting.updateGhostCells();
+   ok = ok && adopting.getStorage() == adoptedBuffer.data() && adopting.getData().empty()
+      && std::equal(adoptedBuffer.begin(), adoptedBuffer.end(), owner.getStorage());
+
+   adopting.finalize();
+   wrapped.finalize();
+   owner.finalize();
+   return checkPassed("Wrapped and adopted storage", ok);
+}
+
+bool checkArena(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 2> Cell;
+   FsGrid<Cell, 2> owner(globalSize, MPI_COMM_WORLD, {true, false, true});
+   fillGrid(owner, checkValue);
+   owner.updateGhostCells();
+
+   // Room for exactly two grids
+   const size_t footprint = FsGridArena::footprint<Cell>(owner.getStorageCells());
+   FsGridArena arena(std::max(2 * footprint, FsGridArena::alignment));
+   FsGrid<Cell, 2> persistent(owner.getTopology(), &arena);
+   fillGrid(persistent, checkValue);
+   persistent.updateGhostCells();
+   const size_t mark = arena.mark();
+   Cell* temporaryStorage;
+   {
+      FsGrid<Cell, 2> temporary(owner.getTopology(), &arena);
+      fillGrid(temporary, smoothValue);
+      temporary.updateGhostCells();
+      temporaryStorage = temporary.getStorage();
+      temporary.finalize();
+   }
+   bool ok = arena.getUsed() == 2 * footprint;
+   arena.release(mark);
+   ok = ok && arena.getUsed() == footprint;
+   // Released memory is handed out again, without disturbing the grid allocated before the mark
+   FsGrid<Cell, 2> reused(owner.getTopology(), &arena);
+   ok = ok && reused.getStorage() == temporaryStorage && arena.getPeak() == 2 * footprint
+      && std::equal(persistent.getStorage(), persistent.getStorage() + persistent.getStorageCells(), owner.getStorage());
+
+   reused.finalize();
+   persistent.finalize();
+   owner.finalize();
+   return checkPassed("Grids in an arena, with mark and release", ok);
+}
+
+bool checkTimeLevels(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 2> Cell;
+   FsGridTimeLevels<Cell, 2> levels(3, globalSize, MPI_COMM_WORLD, {true, false, true});
+   // Tells the time levels' contents apart
+   auto levelValue = [](int level) {
+      return [level](int c, int x, int y, int z) { return checkValue(c, x, y, z) + 1e7 * level; };
+   };
+   for(int i = 0; i < 3; i++) {
+      fillGrid(levels[i], levelValue(i));
+   }
+   std::array<Cell*, 3> storage = {levels[0].getStorage(), levels[1].getStorage(), levels[2].getStorage()};
+
+   // Every level moves one back, and the oldest one's storage becomes the current level
+   levels.rotate();
+   bool ok = gridMatches(levels[0], levelValue(2)) && gridMatches(levels[1], levelValue(0))
+      && gridMatches(levels[2], levelValue(1));
+   ok = ok && levels[0].getStorage() == storage[2] && levels[1].getStorage() == storage[0]
+      && levels[2].getStorage() == storage[1];
+
+   levels.copyLevel(1, 0);
+   levels.updateGhostCells(0);
+   ok = ok && gridMatches(levels[0], levelValue(0)) && gridMatches(levels[1], levelValue(0));
+   levels.finalize();
+   return checkPassed("Time level rotation and copy", ok);
+}
+
+bool checkSibling(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   FsGrid<std::array<double, 2>, 2> parent(globalSize, MPI_COMM_WORLD, {true, false, true});
+   parent.DX = 0.5;
+   fillGrid(parent, checkValue);
+   typedef FsGrid<std::array<float, 3>, 1, FsGridLayoutSoA> Sibling;
+   Sibling sibling = Sibling::siblingOf(parent);
+   fillGrid(sibling, checkValue);
+   parent.updateGhostCells();
+   sibling.updateGhostCells();
+   bool ok = sibling.getTopology() == parent.getTopology() && sibling.DX == 0.5
+      && sibling.getLocalSize() == parent.getLocalSize() && gridMatches(parent, checkValue) && gridMatches(sibling, checkValue);
+   // The periodic ghost cell left of the first local cell
+   if(sibling.getRank() != -1) {
+      const std::array<FsGridTools::FsIndex_t, 3> start = sibling.getLocalStart();
+      const int x = (start[0] + globalSize[0] - 1) % globalSize[0];
+      for(int c = 0; c < 3; c++) {
+         ok = ok && (*sibling.get(sibling.LocalIDForCoords(-1, 0, 0)))[c] == (float)checkValue(c, x, start[1], start[2]);
+      }
+   }
+   sibling.finalize();
+   parent.finalize();
+   return checkPassed("Sibling grid with its own layout on a shared topology", ok);
+}
+
+bool checkRestart(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   const char* path = "fsgrid_benchmark_check.bin";
+   typedef std::array<double, 4> Cell;
+   FsGrid<Cell, 1, FsGridLayoutSoA> written(globalSize, MPI_COMM_WORLD, {true, false, true});
+   FsGrid<Cell, 2> read(globalSize, MPI_COMM_WORLD, {true, true, true}, otherDecomposition(written.getDecomposition()));
+   fillGrid(written, checkValue);
+   written.DX = 0.25;
+   written.physicalGlobalStart = {1, 2, -3};
+   written.writeCheckpoint(path);
+   // Non-FS tasks return from writeCheckpoint() at once, and must not read the header before it's written
+   MPI_Barrier(MPI_COMM_WORLD);
+   read.readCheckpoint(path);
+   const bool ok = gridMatches(read, checkValue) && read.DX == 0.25 && read.physicalGlobalStart[2] == -3;
+   MPI_Barrier(MPI_COMM_WORLD);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   if(rank==0)
+      remove(path);
+   read.finalize();
+   written.finalize();
+   return checkPassed("Checkpoint restart on a different decomposition and layout", ok);
+}
+
+bool checkAsyncCheckpoint(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   const char* path = "fsgrid_benchmark_check.bin";
+   typedef std::array<double, 3> Cell;
+   FsGrid<Cell, 1> grid(globalSize, MPI_COMM_WORLD, {true, true, false});
+   FsGridAsyncCheckpoint<Cell> checkpoint(grid);
+   fillGrid(grid, checkValue);
+   checkpoint.start(grid, path);
+   // The file must hold the grid as it was when the checkpoint started
+   fillGrid(grid, smoothValue);
+   checkpoint.wait();
+   MPI_Barrier(MPI_COMM_WORLD);
+   FsGrid<Cell, 1> read(globalSize, MPI_COMM_WORLD, {true, true, false}, otherDecomposition(grid.getDecomposition()));
+   read.readCheckpoint(path);
+   const bool ok = gridMatches(read, checkValue) && gridMatches(grid, smoothValue);
+   MPI_Barrier(MPI_COMM_WORLD);
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   if(rank==0)
+      remove(path);
+   read.finalize();
+   checkpoint.finalize();
+   grid.finalize();
+   return checkPassed("Asynchronous checkpoint holds the grid as it was at start()", ok);
+}
+
+bool checkChunked(const char* name, FsGridCompression compression, std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 3> Cell;
+   FsGrid<Cell, 2> grid(globalSize, MPI_COMM_WORLD, {true, false, true});
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   const char* path = "fsgrid_benchmark_check.bin";
+   fillGrid(grid, smoothValue);
+   grid.writeChunked(path, {16, 8, 8}, compression);
+   MPI_Barrier(MPI_COMM_WORLD);
+   bool ok = true;
+   if(rank==0) {
+      FsGridChunkedReader reader(path);
+      bool encoded = compression.codec == FsGridCompression::none;
+      for(size_t i = 0; i < reader.getNumChunks(); i++) {
+         encoded = encoded || reader.getChunk(i).codec == compression.codec;
+      }
+      // A box cutting through chunks, of two of the three components
+      const std::array<FsGridTools::FsIndex_t, 3> start = {3, 5, 2};
+      const std::array<FsGridTools::FsIndex_t, 3> size = {(FsGridTools::FsIndex_t)globalSize[0] - 7,
+         (FsGridTools::FsIndex_t)globalSize[1] - 6, (FsGridTools::FsIndex_t)globalSize[2] - 3};
+      std::vector<double> box((size_t)size[0] * size[1] * size[2] * 2);
+      reader.readBox<double>(start, size, 1, 2, box.data());
+      double maxError = 0;
+      size_t i = 0;
+      for(int z = 0; z < size[2]; z++) {
+         for(int y = 0; y < size[1]; y++) {
+            for(int x = 0; x < size[0]; x++) {
+               for(int c = 1; c < 3; c++) {
+                  maxError = std::max(maxError, std::abs(box[i++] - smoothValue(c, start[0] + x, start[1] + y, start[2] + z)));
+               }
+            }
+         }
+      }
+      ok = encoded && maxError <= compression.errorBound;
+      remove(path);
+   }
+   grid.finalize();
+   return checkPassed(name, ok);
+}
+
+bool checkCoarsening(int factor, std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 2> Cell;
+   FsGrid<Cell, 2, FsGridLayoutSoA> fine(globalSize, MPI_COMM_WORLD, {true, false, true});
+   std::array<FsGridTools::FsSize_t, 3> coarseSize;
+   for(int i = 0; i < 3; i++) {
+      coarseSize[i] = (globalSize[i] + factor - 1) / factor;
+   }
+   FsGrid<Cell, 1> coarse(coarseSize, MPI_COMM_WORLD, {true, false, true});
+   fillGrid(fine, smoothValue);
+   FsGridCoarsening<Cell> coarsening(fine, coarse, factor, MPI_COMM_WORLD);
+   coarsening.execute(fine, coarse);
+
+   // Serial reference: plain average over each (possibly truncated) block
+   const std::array<FsGridTools::FsIndex_t, 3> start = coarse.getLocalStart();
+   bool ok = true;
+   coarse.forEachCell([&](int x, int y, int z, Cell* cell) {
+      const int X = start[0] + x, Y = start[1] + y, Z = start[2] + z;
+      for(int c = 0; c < 2; c++) {
+         double sum = 0;
+         int n = 0;
+         for(int zz = Z * factor; zz < std::min<int>((Z + 1) * factor, globalSize[2]); zz++) {
+            for(int yy = Y * factor; yy < std::min<int>((Y + 1) * factor, globalSize[1]); yy++) {
+               for(int xx = X * factor; xx < std::min<int>((X + 1) * factor, globalSize[0]); xx++) {
+                  sum += smoothValue(c, xx, yy, zz);
+                  n++;
+               }
+            }
+         }
+         ok = ok && std::abs((*cell)[c] - sum / n) <= 1e-12;
+      }
+   }, FsGridSerial());
+   coarsening.finalize();
+   coarse.finalize();
+   fine.finalize();
+   return checkPassed(factor == 2 ? "Coarsening by 2 against a serial average" : "Coarsening with truncated blocks against a serial average", ok);
+}
+
+bool checkSlice(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 3> Cell;
+   FsGrid<Cell, 2> grid(globalSize, MPI_COMM_WORLD, {true, false, true});
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   fillGrid(grid, checkValue);
+   bool ok = true;
+   for(int axis = 0; axis < 3; axis++) {
+      // Plane at index along axis, spanned by the other two dimensions, lower one fastest
+      const int a = axis == 0 ? 1 : 0;
+      const int b = axis == 2 ? 1 : 2;
+      const int index = globalSize[axis] / 2;
+      std::vector<double> plane(rank == 0 ? (size_t)globalSize[a] * globalSize[b] * 2 : 0);
+      grid.extractSlice(axis, index, 1, 2, plane.data());
+      std::vector<double> line(rank == 0 ? globalSize[axis] * 3 : 0);
+      const std::array<FsGridTools::FsIndex_t, 3> through = {(FsGridTools::FsIndex_t)globalSize[0] / 3,
+         (FsGridTools::FsIndex_t)globalSize[1] / 3, (FsGridTools::FsIndex_t)globalSize[2] - 1};
+      grid.extractLine(axis, through, 0, 3, line.data());
+      if(rank != 0) {
+         continue;
+      }
+      size_t i = 0;
+      for(FsGridTools::FsSize_t v = 0; v < globalSize[b]; v++) {
+         for(FsGridTools::FsSize_t u = 0; u < globalSize[a]; u++) {
+            std::array<int, 3> cell;
+            cell[axis] = index;
+            cell[a] = u;
+            cell[b] = v;
+            for(int c = 1; c < 3; c++) {
+               ok = ok && plane[i++] == checkValue(c, cell[0], cell[1], cell[2]);
+            }
+         }
+      }
+      for(FsGridTools::FsSize_t j = 0; j < globalSize[axis]; j++) {
+         std::array<FsGridTools::FsIndex_t, 3> cell = through;
+         cell[axis] = j;
+         for(int c = 0; c < 3; c++) {
+            ok = ok && line[j * 3 + c] == checkValue(c, cell[0], cell[1], cell[2]);
+         }
+      }
+   }
+   grid.finalize();
+   return checkPassed("Slice and line extraction", ok);
+}
+
+bool checkReduce(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   typedef std::array<double, 3> Cell;
+   FsGrid<Cell, 2> grid(globalSize, MPI_COMM_WORLD, {true, false, true});
+   fillGrid(grid, smoothValue);
+   grid.setTileSize({8, 4, 4});
+   auto reduce = [&](auto&& executor) {
+      return grid.reduce<FsGridReduction::sum, FsGridReduction::min, FsGridReduction::max, FsGridReduction::argmax>(
+            [](int x, int y, int z, Cell* cell) { return std::array<double, 4>{(*cell)[0], (*cell)[1], (*cell)[2], (*cell)[2]}; },
+            executor);
+   };
+
+   double sum = 0, min = std::numeric_limits<double>::infinity(), max = -min;
+   std::array<FsGridTools::FsIndex_t, 3> maxLocation = {-1, -1, -1};
+   for(int z = 0; z < (int)globalSize[2]; z++) {
+      for(int y = 0; y < (int)globalSize[1]; y++) {
+         for(int x = 0; x < (int)globalSize[0]; x++) {
+            sum += smoothValue(0, x, y, z);
+            min = std::min(min, smoothValue(1, x, y, z));
+            if(smoothValue(2, x, y, z) > max) {
+               max = smoothValue(2, x, y, z);
+               maxLocation = {x, y, z};
+            }
+         }
+      }
+   }
+   bool ok = true;
+   for(const auto& r : {reduce(FsGridOpenMP()), reduce(FsGridThreadPool(3))}) {
+      ok = ok && std::abs(r[0].value - sum) <= 1e-9 * std::abs(sum) && r[1].value == min && r[2].value == max
+         && r[3].value == max && r[3].location == maxLocation;
+   }
+   grid.finalize();
+   return checkPassed("Fused reduction on OpenMP and a thread pool against a serial reference", ok);
+}
+
+bool checkIallreduce(std::array<FsGridTools::FsSize_t, 3> globalSize){
+   FsGrid<std::array<double, 1>, 1> grid(globalSize, MPI_COMM_WORLD, {true, true, true});
+   const std::array<FsGridTools::Task_t, 3> decomposition = grid.getDecomposition();
+   const int tasks = decomposition[0] * decomposition[1] * decomposition[2];
+   // Non-FS tasks pass values which mustn't make it into the result
+   const int value = grid.getRank() != -1 ? grid.getRank() + 1 : -1000;
+   auto sum = grid.Iallreduce(value, MPI_SUM);
+   auto extremes = grid.Iallreduce(std::array<double, 2>{(double)value, -(double)value}, MPI_MAX);
+   const std::array<double, 2>& e = extremes.wait();
+   const bool ok = sum.wait()[0] == tasks * (tasks + 1) / 2 && e[0] == tasks && e[1] == -1;
+   grid.finalize();
+   return checkPassed("Non-blocking reduction result on all tasks", ok);
+}
+
+bool checkProbes(std::array<FsGridTools::FsSize_t, 3> globalSize, int numProbes){
+   typedef std::array<double, 2> Cell;
+   FsGrid<Cell, 1> grid(globalSize, MPI_COMM_WORLD, {false, false, false});
+   int rank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   grid.DX = 0.5;
+   grid.DY = 0.25;
+   grid.DZ = 2;
+   grid.physicalGlobalStart = {-3, 1, 10};
+   // Linear in the physical coordinates of the cell centres, which trilinear interpolation reproduces exactly
+   auto linear = [&](int c, double x, double y, double z) { return c + 0.5 * x - 2 * y + 0.25 * z; };
+   fillGrid(grid, [&](int c, int x, int y, int z) {
+      return linear(c, -3 + (x + 0.5) * 0.5, 1 + (y + 0.5) * 0.25, 10 + (z + 0.5) * 2);
+   });
+   grid.updateGhostCells();
+
+   // Scattered between the first and last cell centres, where no boundary clamping happens
+   std::vector<std::array<double, 3>> positions(numProbes);
+   const std::array<double, 3> spacing = {0.5, 0.25, 2};
+   for(int i = 0; i < numProbes; i++) {
+      for(int d = 0; d < 3; d++) {
+         const double u = std::fmod((i + 1) * (0.618034 + 0.1 * d + 0.01 * rank), 1.0);
+         positions[i][d] = grid.physicalGlobalStart[d] + (0.5 + u * (globalSize[d] - 1)) * spacing[d];
+      }
+   }
+   FsGridProbes<Cell> probes(grid, MPI_COMM_WORLD, positions);
+   std::vector<double> values(numProbes * 2);
+   probes.sample(grid, 0, 2, values.data());
+   bool ok = true;
+   for(int i = 0; i < numProbes; i++) {
+      for(int c = 0; c < 2; c++) {
+         const double expected = linear(c, positions[i][0], positions[i][1], positions[i][2]);
+         ok = ok && std::abs(values[i * 2 + c] - expected) <= 1e-12 * (1 + std::abs(expected));
+      }
+   }
+   probes.finalize();
+   grid.finalize();
+   return checkPassed("Probes interpolating a linear field", ok);
+}
 
 int main(int argc, char** argv) {
    
-   MPI_Init(&argc,&argv);
+   // Threaded MPI where available, so the asynchronous checkpoint check runs its writer thread
+   int provided;
+   MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
 
    int rank,size;
    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
    MPI_Comm_size(MPI_COMM_WORLD, &size);
 
    // Create a 8×8 Testgrid
-   std::array<int32_t, 3> globalSize{2000,1000,1};
+   std::array<FsGridTools::FsSize_t, 3> globalSize{2000,1000,1};
    std::array<bool, 3> isPeriodic{false,false,true};
 
    const int iterations = 200;
 
+   int failures = 0;
+   failures += !checkTransferPlan({48, 20, 24});
+   failures += !checkTransferToAllTasks({48, 20, 24});
+   failures += !checkCoupling({31, 17, 12});
+   failures += !checkThreadPool({37, 22, 9});
+   failures += !checkGhostCells<FsGridLayoutAoS>("Ghost cells, array-of-structs", {13, 11, 7}, {true, false, true});
+   failures += !checkGhostCells<FsGridLayoutSoA>("Ghost cells, struct-of-arrays", {13, 11, 7}, {true, false, true});
+   failures += !checkGhostCells<FsGridLayoutAoSoA<4>>("Ghost cells, tiles of 4", {13, 11, 7}, {true, false, true});
+   failures += !checkGhostCells<FsGridLayoutAoSoA<8>>("Ghost cells, tiles of 8", {13, 11, 7}, {false, true, true});
+   failures += !checkGhostCells<FsGridLayoutPadded<>>("Ghost cells, padded array-of-structs", {124, 12, 8}, {true, true, true});
+   failures += !checkGhostCells<FsGridLayoutPadded<FsGridLayoutSoA, 64>>("Ghost cells, padded struct-of-arrays", {12, 12, 8},
+         {true, false, true});
+   failures += !checkGhostCells<FsGridLayout2D<>>("Ghost cells, 2D", {23, 17, 1}, {true, true, false});
+   failures += !checkGhostCells<FsGridLayout2D<FsGridLayoutSoA>>("Ghost cells, 2D struct-of-arrays", {23, 17, 1}, {false, true, false});
+   failures += !checkGhostCells<FsGridLayout1D<>>("Ghost cells, 1D", {57, 1, 1}, {true, false, false});
+   failures += !checkExternalStorage({31, 17, 12});
+   failures += !checkArena({31, 17, 12});
+   failures += !checkTimeLevels({31, 17, 12});
+   failures += !checkSibling({31, 17, 12});
+   failures += !checkRestart({31, 17, 12});
+   failures += !checkAsyncCheckpoint({31, 17, 12});
+   failures += !checkChunked("Chunked output read back, uncompressed", FsGridCompression(), {40, 33, 20});
+   failures += !checkChunked("Chunked output read back, lossless codec bit-exact", FsGridCompression::losslessCompression(), {40, 33, 20});
+   failures += !checkChunked("Chunked output read back, quantised codec within its error bound",
+         FsGridCompression::quantisedCompression(1e-4), {40, 33, 20});
+   failures += !checkCoarsening(2, {40, 30, 20});
+   failures += !checkCoarsening(3, {41, 31, 19});
+   failures += !checkSlice({40, 30, 20});
+   failures += !checkReduce({40, 30, 20});
+   failures += !checkIallreduce({40, 30, 20});
+   failures += !checkProbes({40, 30, 20}, 1000);
+
    timeit<std::array<double,1>, 2>(globalSize, isPeriodic, iterations);
    timeit<std::array<double,2>, 2>(globalSize, isPeriodic, iterations);
    timeit<std::array<double,4>, 2>(globalSize, isPeriodic, iterations);
@@ -64,8 +1274,38 @@ int main(int argc, char** argv) {
    timeit<std::array<double,32>, 2>(globalSize, isPeriodic, iterations);
    timeit<std::array<double,64>, 2>(globalSize, isPeriodic, iterations);
    timeit<std::array<double,128>, 2>(globalSize, isPeriodic, iterations);
+
+   timeCoupling<std::array<double,8>, 2>(globalSize, isPeriodic, 20);
+   timeLookup<std::array<double,1>, 2>(globalSize, isPeriodic, 10);
+   timeConstruction<std::array<double,8>, 2>({32, 32, 32}, {true, true, true}, 20);
+   timeTiling<2>({256, 256, 128}, {true, true, true}, 10);
+
+   timeLayout<FsGridLayoutAoS>("AoS", {128, 128, 128}, {true, true, true}, 10);
+   timeLayout<FsGridLayoutSoA>("SoA", {128, 128, 128}, {true, true, true}, 10);
+   timeLayout<FsGridLayoutAoSoA<4>>("AoSoA<4>", {128, 128, 128}, {true, true, true}, 10);
+   timeLayout<FsGridLayoutAoSoA<8>>("AoSoA<8>", {128, 128, 128}, {true, true, true}, 10);
+
+   timePadding<FsGridLayoutAoS>("AoS", {62, 62, 62}, {true, true, true}, 300);
+   timePadding<FsGridLayoutPadded<>>("AoS padded", {62, 62, 62}, {true, true, true}, 300);
+   timePadding<FsGridLayoutAoS>("AoS", {254, 254, 126}, {true, true, true}, 10);
+   timePadding<FsGridLayoutPadded<>>("AoS padded", {254, 254, 126}, {true, true, true}, 10);
+
+   timeDimensions<FsGridLayoutAoS>("runtime 2D", {1024, 1024, 1}, {true, true, true}, 50);
+   timeDimensions<FsGridLayout2D<>>("compile-time 2D", {1024, 1024, 1}, {true, true, true}, 50);
+
+   timeCheckpoint<FsGridLayoutAoS>("AoS", {128, 128, 128}, {true, true, true}, 5);
+   timeCheckpoint<FsGridLayoutSoA>("SoA", {128, 128, 128}, {true, true, true}, 5);
+   timeChunked("uncompressed", FsGridCompression(), {128, 128, 128}, {true, true, true}, 5);
+   timeChunked("lossless", FsGridCompression::losslessCompression(), {128, 128, 128}, {true, true, true}, 5);
+   timeChunked("quantised to 1e-6", FsGridCompression::quantisedCompression(1e-6), {128, 128, 128}, {true, true, true}, 5);
+   timeCoarsening(2, {128, 128, 128}, {true, true, true}, 10);
+   timeCoarsening(4, {128, 128, 128}, {true, true, true}, 10);
+   timeSlice({256, 256, 128}, {true, true, true}, 50);
+   timeReduce({128, 128, 128}, {true, true, true}, 20);
+   timeIallreduce({64, 64, 64}, {true, true, true}, 100);
+   timeProbes({128, 128, 128}, {true, true, true}, 10000, 20);
    
       
    MPI_Finalize();
-   return 0;
+   return failures == 0 ? 0 : 1;
 }